@@ -20,10 +20,12 @@
 
 #include <type_traits>
 #include <algorithm>
+#include <array>
 #include <filesystem>
 #include <cstddef>
 #include <fstream>
 #include <memory>
+#include <stdexcept>
 #include "bytes.h"
 
 // check if system is Big/Little endian
@@ -222,15 +224,10 @@ namespace binIO {
             inline void write(const T (&x)[N]) const
             {
                 static_assert(std::is_arithmetic_v<T>, "BinaryFile can write only arithmetic type arrays.");
-                if constexpr (en != std::endian::native) {
-                    // for-range loop
-                    for (T& y : x) {
-                        y = reverseBytes(y);
-                        write(reinterpret_cast<char*>(y),sizeof(T));
-                    }
-                }else {
+                if constexpr (en != std::endian::native && sizeof(T) > 1)
+                    write<en>(&x[0], N);
+                else
                     write(reinterpret_cast<const char*>(x),sizeof(T)*N);
-                }
             }
             // Write elements to std::array<T,N>
             template<std::endian en = std::endian::native, class T, std::size_t N>
@@ -240,15 +237,16 @@ namespace binIO {
             }
             // Write n elements to pointer array *x of type T
             template<std::endian en = std::endian::native, class T, std::enable_if_t<!std::is_same_v<T,char>, bool> = true>
-            inline void write(const T* x, std::size_t n)
+            inline void write(const T* x, std::size_t n) const
             {
                 static_assert(std::is_arithmetic_v<T>, "BinaryFile can write only arithmetic type arrays.");
                 if constexpr (en != std::endian::native) {
-                    //can't use for-range loop with pointers
-                    T y;
-                    for (std::size_t i=0; i<n; ++i) {
-                        y = reverseBytes(x[i]);
-                        write(reinterpret_cast<const char*>(y),sizeof(T));
+                    // swap through a small buffer, written block by block
+                    std::array<T,4096/sizeof(T)> y;
+                    for (std::size_t i=0; i<n; i+=y.size()) {
+                        const std::size_t m = std::min(y.size(), n-i);
+                        std::transform(x+i, x+i+m, y.begin(), [](const T v) { return reverseBytes(v); });
+                        write(reinterpret_cast<const char*>(y.data()),sizeof(T)*m);
                     }
                 } else {
                     write(reinterpret_cast<const char*>(x),sizeof(T)*n);
@@ -0,0 +1,673 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _Defrag_h
+#define _Defrag_h
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Heuristic solver of the VM defragmentation model of the repository README:
+//
+//   min  alpha * sum_j z_j + sum_i y_i
+//
+// with each VM on exactly one host, host CPU capacities, anti-affinity groups, VMs that can't be
+// migrated (b_i = 0 or i in unMig) and hosts that can't hold any VM (notMig, x_ij = 0 for all i).
+// A plan is the host of every VM: y_i = 1 if it differs from the original host, z_j = 1 if any
+// VM is on host j.
+
+namespace Defrag {
+
+    typedef std::ptrdiff_t Index;
+
+    // Cluster snapshot, structure of arrays
+    template<typename _Scalar = double>
+    struct Cluster
+    {
+        typedef _Scalar Scalar;
+
+        std::vector<Scalar> host_capacity;          // P_j
+        std::vector<std::uint8_t> host_closed;      // 1 if j is in notMig
+        std::vector<Scalar> vm_demand;              // P_i
+        std::vector<std::int32_t> vm_host;          // original host of VM i (x0)
+        std::vector<std::uint8_t> vm_allowed;       // b_i
+        std::vector<std::uint8_t> vm_unmig;         // 1 if i is in unMig
+        // anti-affinity groups: VMs of group k are group_vms[group_offsets[k]] ... group_vms[group_offsets[k+1]-1]
+        std::vector<std::uint64_t> group_offsets{0};
+        std::vector<std::int32_t> group_vms;
+
+        inline Index num_hosts() const { return Index(host_capacity.size()); }
+        inline Index num_vms() const { return Index(vm_demand.size()); }
+        inline Index num_groups() const { return Index(group_offsets.size()) - 1; }
+
+        // VM can't leave its original host
+        inline bool pinned(const Index i) const { return !vm_allowed[i] || vm_unmig[i]; }
+
+        inline Index add_host(const Scalar capacity, const bool closed = false)
+        {
+            host_capacity.push_back(capacity);
+            host_closed.push_back(closed);
+            return num_hosts() - 1;
+        }
+
+        inline Index add_vm(const Scalar demand, const Index host, const bool allowed = true, const bool unmig = false)
+        {
+            vm_demand.push_back(demand);
+            vm_host.push_back(std::int32_t(host));
+            vm_allowed.push_back(allowed);
+            vm_unmig.push_back(unmig);
+            return num_vms() - 1;
+        }
+
+        template<typename _Container>
+        inline Index add_group(const _Container& vms)
+        {
+            group_vms.insert(group_vms.end(), std::begin(vms), std::end(vms));
+            group_offsets.push_back(group_vms.size());
+            return num_groups() - 1;
+        }
+
+        // throws if arrays are inconsistent
+        inline void check() const
+        {
+            if (host_closed.size() != host_capacity.size())
+                throw std::runtime_error("Cluster: host arrays must have same size");
+            if (vm_host.size() != vm_demand.size() || vm_allowed.size() != vm_demand.size() || vm_unmig.size() != vm_demand.size())
+                throw std::runtime_error("Cluster: VM arrays must have same size");
+            if (group_offsets.empty() || group_offsets.front() != 0 || group_offsets.back() != group_vms.size() ||
+                    !std::is_sorted(group_offsets.begin(), group_offsets.end()))
+                throw std::runtime_error("Cluster: invalid anti-affinity group offsets");
+            for (const std::int32_t j : vm_host)
+                if (j < 0 || j >= num_hosts())
+                    throw std::runtime_error("Cluster: VM original host out of range");
+            for (const std::int32_t i : group_vms)
+                if (i < 0 || i >= num_vms())
+                    throw std::runtime_error("Cluster: anti-affinity group VM out of range");
+        }
+    };
+
+    struct Score
+    {
+        double objective = 0.0;
+        Index active_hosts = 0;
+        Index migrations = 0;
+        bool feasible = false;
+    };
+
+    struct Plan
+    {
+        std::vector<std::int32_t> host;     // host of every VM
+        Score score;
+        Index iterations = 0;               // local search iterations (all threads)
+    };
+
+    // objective and feasibility of "host" (all constraints checked from scratch)
+    template<typename _Scalar>
+    inline Score score(const Cluster<_Scalar>& cluster, const std::vector<std::int32_t>& host, const double alpha)
+    {
+        Score s;
+        const Index n = cluster.num_vms(), m = cluster.num_hosts();
+        if (Index(host.size()) != n)
+            return s;
+        std::vector<_Scalar> load(m, _Scalar(0));
+        std::vector<std::uint8_t> active(m, 0);
+        bool feasible = true;
+        for (Index i = 0; i < n; ++i) {
+            const Index j = host[i];
+            if (j < 0 || j >= m || cluster.host_closed[j]) {
+                feasible = false;
+                continue;
+            }
+            load[j] += cluster.vm_demand[i];
+            active[j] = 1;
+            if (j != cluster.vm_host[i]) {
+                ++s.migrations;
+                feasible &= !cluster.pinned(i);
+            }
+        }
+        for (Index j = 0; j < m; ++j) {
+            s.active_hosts += active[j];
+            feasible &= !(load[j] > cluster.host_capacity[j]);
+        }
+        // anti-affinity: no host twice in a group (stamp of last group seen on each host, and on each
+        // VM so that a VM listed twice in a group counts once)
+        std::vector<Index> stamp(m, -1), seen(n, -1);
+        for (Index k = 0; k < cluster.num_groups() && feasible; ++k)
+            for (std::uint64_t g = cluster.group_offsets[k]; g < cluster.group_offsets[k+1]; ++g) {
+                const Index i = cluster.group_vms[g], j = host[i];
+                if (seen[i] == k)
+                    continue;
+                seen[i] = k;
+                feasible &= stamp[j] != k;
+                stamp[j] = k;
+            }
+        s.feasible = feasible;
+        s.objective = alpha*double(s.active_hosts) + double(s.migrations);
+        return s;
+    }
+
+    struct Options
+    {
+        double alpha = 10.0;                    // weight of active hosts against migrations
+        double time_limit = 1.0;                // seconds of a whole solve (greedy starts and local search)
+        Index max_iterations = 0;               // local search iterations per thread (0: no limit)
+        Index max_idle = Index(1) << 20;        // stop a thread after so many iterations without improvement
+        unsigned int num_threads = 0;           // local search threads (0: all cores)
+        std::uint64_t seed = 1;
+    };
+
+    // Solver: two greedy starts (first-fit decreasing packing, and the original placement with VMs
+    // moved only when they must), improved by local search. Every thread runs an independent search
+    // with its own random stream, threads alternating between the better and the other start; the
+    // best plan is returned.
+    //
+    // Search moves, each evaluated with the incremental objective change:
+    //  - ruin and recreate: take out all VMs of a lightly loaded host and the migrated VMs of a few
+    //    random hosts, reinsert them by decreasing demand in hosts still in use (original host
+    //    first, then the fullest of a random sample, then first fit), undone if the objective grows
+    //  - return home: move a migrated VM back to its active original host
+    //  - consolidate: move a migrated VM from a lightly loaded host to a fuller one, so that light
+    //    hosts can be emptied later
+    template<typename _Scalar = double>
+    class Solver
+    {
+        public:
+            typedef _Scalar Scalar;
+
+            Solver(const Cluster<Scalar>& cluster, const Options& options = Options())
+            : _cluster(cluster), _options(options), _vm_group_offsets(), _vm_groups(), _pinned_count(), _order(), _rank()
+            {
+                _cluster.check();
+                const Index n = _cluster.num_vms(), m = _cluster.num_hosts();
+
+                // groups of each VM
+                _vm_group_offsets.assign(n + 1, 0);
+                for (const std::int32_t i : _cluster.group_vms)
+                    ++_vm_group_offsets[i+1];
+                std::partial_sum(_vm_group_offsets.begin(), _vm_group_offsets.end(), _vm_group_offsets.begin());
+                _vm_groups.resize(_cluster.group_vms.size());
+                std::vector<std::int32_t> fill(_vm_group_offsets.begin(), _vm_group_offsets.end() - 1);
+                for (Index k = 0; k < _cluster.num_groups(); ++k)
+                    for (std::uint64_t g = _cluster.group_offsets[k]; g < _cluster.group_offsets[k+1]; ++g)
+                        _vm_groups[fill[_cluster.group_vms[g]]++] = std::int32_t(k);
+                // a VM listed twice in a group counts once (groups of each VM are in increasing order)
+                std::int32_t size = 0;
+                for (Index i = 0; i < n; ++i) {
+                    const std::int32_t begin = _vm_group_offsets[i];
+                    _vm_group_offsets[i] = size;
+                    for (std::int32_t g = begin; g < fill[i]; ++g)
+                        if (g == begin || _vm_groups[g] != _vm_groups[g-1])
+                            _vm_groups[size++] = _vm_groups[g];
+                }
+                _vm_group_offsets[n] = size;
+                _vm_groups.resize(size);
+
+                // first fit order of open hosts: most pinned load first, then most original load
+                std::vector<Scalar> pinned_load(m, Scalar(0)), load(m, Scalar(0));
+                _pinned_count.assign(m, 0);
+                for (Index i = 0; i < n; ++i) {
+                    load[_cluster.vm_host[i]] += _cluster.vm_demand[i];
+                    if (_cluster.pinned(i)) {
+                        pinned_load[_cluster.vm_host[i]] += _cluster.vm_demand[i];
+                        ++_pinned_count[_cluster.vm_host[i]];
+                    }
+                }
+                for (Index j = 0; j < m; ++j)
+                    if (!_cluster.host_closed[j])
+                        _order.push_back(std::int32_t(j));
+                std::stable_sort(_order.begin(), _order.end(), [&](const std::int32_t a, const std::int32_t b) {
+                    return pinned_load[a] != pinned_load[b] ? pinned_load[a] > pinned_load[b] : load[a] > load[b];
+                });
+                _rank.assign(m, -1);
+                for (Index p = 0; p < Index(_order.size()); ++p)
+                    _rank[_order[p]] = std::int32_t(p);
+            }
+
+            // pack all migratable VMs by first fit decreasing (VMs stay on their host if it's already in use)
+            inline Plan first_fit_decreasing() const { return _Plan(_FirstFitDecreasing(), 0); }
+
+            // original placement, moving (first fit decreasing) only VMs that break a constraint
+            inline Plan repaired() const { return _Plan(_Repaired(), 0); }
+
+            // best start improved by local search, within options.time_limit seconds from the call
+            // (greedy starts included; the starts are always completed)
+            inline Plan solve() const
+            {
+                const auto deadline = std::chrono::steady_clock::now() +
+                                      std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(_options.time_limit));
+                const State ffd = _FirstFitDecreasing(), repaired = _Repaired();
+                const bool ffd_first = ffd.objective() <= repaired.objective();
+
+                unsigned int num_threads = _options.num_threads;
+                if (num_threads == 0)
+                    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+                // threads start alternately from the better and the other start
+                std::vector<State> states;
+                states.reserve(num_threads);
+                for (unsigned int t = 0; t < num_threads; ++t)
+                    states.push_back((t % 2 == 0) == ffd_first ? ffd : repaired);
+                std::vector<Index> iterations(num_threads, 0);
+                std::vector<std::thread> threads;
+                for (unsigned int t = 1; t < num_threads; ++t)
+                    threads.emplace_back([&, t]() { iterations[t] = _Search(states[t], _options.seed + t, deadline); });
+                iterations[0] = _Search(states[0], _options.seed, deadline);
+                for (std::thread& thread : threads)
+                    thread.join();
+
+                unsigned int best = 0;
+                for (unsigned int t = 1; t < num_threads; ++t)
+                    if (states[t].objective() < states[best].objective())
+                        best = t;
+                return _Plan(states[best], std::accumulate(iterations.begin(), iterations.end(), Index(0)));
+            }
+
+        private:
+            // max segment tree of host free capacities over first fit order, for first fit queries
+            class FreeTree
+            {
+                public:
+                    FreeTree() : _size(0), _tree() {}
+                    explicit FreeTree(const Index n) : _size(Index(std::bit_ceil(std::size_t(std::max(n, Index(1)))))),
+                        _tree(2*_size, -std::numeric_limits<Scalar>::infinity()) {}
+
+                    inline void set(const Index p, const Scalar value)
+                    {
+                        Index k = p + _size;
+                        _tree[k] = value;
+                        for (k /= 2; k > 0; k /= 2)
+                            _tree[k] = std::max(_tree[2*k], _tree[2*k+1]);
+                    }
+
+                    // first position >= from with value >= demand, -1 if none
+                    inline Index find(const Scalar demand, const Index from) const { return _Find(1, 0, _size, from, demand); }
+
+                private:
+                    Index _size;
+                    std::vector<Scalar> _tree;
+
+                    inline Index _Find(const Index k, const Index lo, const Index hi, const Index from, const Scalar demand) const
+                    {
+                        if (hi <= from || _tree[k] < demand)
+                            return -1;
+                        if (hi - lo == 1)
+                            return lo;
+                        const Index mid = (lo + hi) / 2;
+                        const Index p = _Find(2*k, lo, mid, from, demand);
+                        return p >= 0 ? p : _Find(2*k+1, mid, hi, from, demand);
+                    }
+            };
+
+            // assignment with incrementally maintained host loads, VM lists, active hosts and objective
+            class State
+            {
+                public:
+                    State(const Solver& solver)
+                    : _s(&solver), host(solver._cluster.num_vms(), -1), load(solver._cluster.num_hosts(), Scalar(0)),
+                      count(solver._cluster.num_hosts(), 0), head(solver._cluster.num_hosts(), -1),
+                      next(solver._cluster.num_vms(), -1), prev(solver._cluster.num_vms(), -1),
+                      active(), active_pos(solver._cluster.num_hosts(), -1), tree(Index(solver._order.size())),
+                      open_hosts(true), migrations(0), group_hosts()
+                    {
+                        for (const std::int32_t j : solver._order)
+                            _Update(j);
+                    }
+
+                    inline double objective() const { return _s->_options.alpha*double(active.size()) + double(migrations); }
+
+                    // another VM of a group of i on host j
+                    inline bool conflict(const Index i, const Index j) const
+                    {
+                        for (std::int32_t g = _s->_vm_group_offsets[i]; g < _s->_vm_group_offsets[i+1]; ++g) {
+                            const auto it = group_hosts.find(_Key(_s->_vm_groups[g], j));
+                            if (it != group_hosts.end() && it->second > std::int32_t(host[i] == j))
+                                return true;
+                        }
+                        return false;
+                    }
+
+                    inline bool fits(const Index i, const Index j) const
+                    {
+                        const Cluster<Scalar>& c = _s->_cluster;
+                        return !c.host_closed[j] && !(load[j] + c.vm_demand[i] > c.host_capacity[j]) && !conflict(i,j);
+                    }
+
+                    // objective change of moving VM i to host j
+                    inline double delta(const Index i, const Index j) const
+                    {
+                        const Index from = host[i], home = _s->_cluster.vm_host[i];
+                        return _s->_options.alpha*(double(count[j] == 0) - double(count[from] == 1)) +
+                               double(j != home) - double(from != home);
+                    }
+
+                    inline void assign(const Index i, const Index j)
+                    {
+                        host[i] = std::int32_t(j);
+                        load[j] += _s->_cluster.vm_demand[i];
+                        prev[i] = -1;
+                        next[i] = head[j];
+                        if (head[j] >= 0)
+                            prev[head[j]] = std::int32_t(i);
+                        head[j] = std::int32_t(i);
+                        if (count[j]++ == 0) {
+                            active_pos[j] = std::int32_t(active.size());
+                            active.push_back(std::int32_t(j));
+                        }
+                        migrations += j != _s->_cluster.vm_host[i];
+                        for (std::int32_t g = _s->_vm_group_offsets[i]; g < _s->_vm_group_offsets[i+1]; ++g)
+                            ++group_hosts[_Key(_s->_vm_groups[g], j)];
+                        _Update(j);
+                    }
+
+                    inline void unassign(const Index i)
+                    {
+                        const Index j = host[i];
+                        migrations -= j != _s->_cluster.vm_host[i];
+                        load[j] -= _s->_cluster.vm_demand[i];
+                        if (prev[i] >= 0)
+                            next[prev[i]] = next[i];
+                        else
+                            head[j] = next[i];
+                        if (next[i] >= 0)
+                            prev[next[i]] = prev[i];
+                        if (--count[j] == 0) {
+                            // reset to avoid drift of empty host loads
+                            load[j] = Scalar(0);
+                            const std::int32_t last = active.back();
+                            active[active_pos[j]] = last;
+                            active_pos[last] = active_pos[j];
+                            active.pop_back();
+                            active_pos[j] = -1;
+                        }
+                        for (std::int32_t g = _s->_vm_group_offsets[i]; g < _s->_vm_group_offsets[i+1]; ++g) {
+                            const auto it = group_hosts.find(_Key(_s->_vm_groups[g], j));
+                            if (--it->second == 0)
+                                group_hosts.erase(it);
+                        }
+                        host[i] = -1;
+                        _Update(j);
+                    }
+
+                    inline double move(const Index i, const Index j)
+                    {
+                        const double d = delta(i,j);
+                        unassign(i);
+                        assign(i,j);
+                        return d;
+                    }
+
+                    // first fit host for VM i ("skip" excluded), -1 if none
+                    inline Index first_fit(const Index i, const Index skip = -1) const
+                    {
+                        const Scalar demand = _s->_cluster.vm_demand[i];
+                        for (Index p = tree.find(demand, 0); p >= 0; p = tree.find(demand, p + 1)) {
+                            const Index j = _s->_order[p];
+                            if (j != skip && !conflict(i,j))
+                                return j;
+                        }
+                        return -1;
+                    }
+
+                    // first fit searches all open hosts (start) or only active ones (local search)
+                    inline void set_open_hosts(const bool open)
+                    {
+                        open_hosts = open;
+                        for (const std::int32_t j : _s->_order)
+                            _Update(j);
+                    }
+
+                    const Solver* _s;
+                    std::vector<std::int32_t> host;
+                    std::vector<Scalar> load;
+                    std::vector<std::int32_t> count;
+                    std::vector<std::int32_t> head, next, prev;         // VMs of each host (linked lists)
+                    std::vector<std::int32_t> active, active_pos;       // active hosts and their positions
+                    FreeTree tree;
+                    bool open_hosts;
+                    Index migrations;
+                    std::unordered_map<std::uint64_t,std::int32_t> group_hosts;    // VMs of each (group, host), if any
+
+                private:
+                    inline std::uint64_t _Key(const Index k, const Index j) const
+                    {
+                        return std::uint64_t(k)*std::uint64_t(_s->_cluster.num_hosts()) + std::uint64_t(j);
+                    }
+
+                    inline void _Update(const Index j)
+                    {
+                        const Index p = _s->_rank[j];
+                        if (p >= 0)
+                            tree.set(p, open_hosts || count[j] > 0 ? _s->_cluster.host_capacity[j] - load[j]
+                                                                   : -std::numeric_limits<Scalar>::infinity());
+                    }
+            };
+
+            const Cluster<Scalar>& _cluster;
+            Options _options;
+            std::vector<std::int32_t> _vm_group_offsets, _vm_groups;   // anti-affinity groups of each VM
+            std::vector<std::int32_t> _pinned_count;                   // pinned VMs of each host
+            std::vector<std::int32_t> _order;                          // open hosts in first fit order
+            std::vector<std::int32_t> _rank;                           // position of each host in _order (-1 closed)
+
+            inline Plan _Plan(const State& state, const Index iterations) const
+            {
+                Plan plan;
+                plan.host = state.host;
+                plan.score = score(_cluster, plan.host, _options.alpha);
+                plan.iterations = iterations;
+                assert(plan.score.feasible && "Solver produced an infeasible plan.");
+                return plan;
+            }
+
+            // state with only pinned VMs, on their original hosts
+            inline State _Pinned() const
+            {
+                State state(*this);
+                for (Index i = 0; i < _cluster.num_vms(); ++i)
+                    if (_cluster.pinned(i)) {
+                        const Index j = _cluster.vm_host[i];
+                        if (!state.fits(i,j))
+                            throw std::runtime_error("Infeasible cluster: pinned VM " + std::to_string(i) +
+                                                     " can't stay on host " + std::to_string(j));
+                        state.assign(i,j);
+                    }
+                return state;
+            }
+
+            // movable VMs by decreasing demand
+            inline std::vector<std::int32_t> _Movable() const
+            {
+                std::vector<std::int32_t> vms;
+                for (Index i = 0; i < _cluster.num_vms(); ++i)
+                    if (!_cluster.pinned(i))
+                        vms.push_back(std::int32_t(i));
+                std::stable_sort(vms.begin(), vms.end(), [this](const std::int32_t a, const std::int32_t b) {
+                    return _cluster.vm_demand[a] > _cluster.vm_demand[b];
+                });
+                return vms;
+            }
+
+            // place VM i on its original host if in use and possible, else on the first fitting host
+            inline void _Place(State& state, const Index i) const
+            {
+                Index j = _cluster.vm_host[i];
+                if (state.count[j] == 0 || !state.fits(i,j))
+                    j = state.first_fit(i);
+                if (j < 0)
+                    throw std::runtime_error("Infeasible cluster: no host can take VM " + std::to_string(i));
+                state.assign(i,j);
+            }
+
+            inline State _FirstFitDecreasing() const
+            {
+                State state = _Pinned();
+                for (const std::int32_t i : _Movable())
+                    _Place(state, i);
+                return state;
+            }
+
+            inline State _Repaired() const
+            {
+                State state = _Pinned();
+                std::vector<std::int32_t> moved;
+                for (const std::int32_t i : _Movable()) {
+                    if (state.fits(i, _cluster.vm_host[i]))
+                        state.assign(i, _cluster.vm_host[i]);
+                    else
+                        moved.push_back(i);
+                }
+                for (const std::int32_t i : moved)
+                    _Place(state, i);
+                return state;
+            }
+
+            // local search until deadline, iteration or idle limits; returns number of iterations
+            inline Index _Search(State& state, const std::uint64_t seed, const std::chrono::steady_clock::time_point deadline) const
+            {
+                constexpr int SampleSize = 8;
+                constexpr int RuinHosts = 2;
+                std::mt19937_64 rng(seed);
+                state.set_open_hosts(false);
+                std::vector<std::pair<std::int32_t,std::int32_t>> removed;     // VMs and their hosts before a move
+
+                auto random_active = [&]() { return Index(state.active[rng() % state.active.size()]); };
+                if (state.active.empty())
+                    return 0;
+                // lightest of a few random active hosts
+                auto light_host = [&]() {
+                    Index j = random_active();
+                    for (int k = 1; k < 4; ++k) {
+                        const Index c = random_active();
+                        if (state.load[c] < state.load[j])
+                            j = c;
+                    }
+                    return j;
+                };
+                // fullest fitting host of a random sample of active hosts, -1 if none
+                auto sampled_fit = [&](const Index i, const Index skip = -1) {
+                    Index best = -1;
+                    for (int k = 0; k < SampleSize && !state.active.empty(); ++k) {
+                        const Index c = random_active();
+                        if (c != skip && (best < 0 || state.load[c] > state.load[best]) && state.fits(i,c))
+                            best = c;
+                    }
+                    return best;
+                };
+
+                Index iteration = 0, idle = 0;
+                while ((_options.max_iterations == 0 || iteration < _options.max_iterations) && idle < _options.max_idle) {
+                    if (iteration % 64 == 0 && std::chrono::steady_clock::now() >= deadline)
+                        break;
+                    ++iteration;
+                    ++idle;
+
+                    const unsigned int move = unsigned(rng() % 4);
+                    if (move == 0) {
+                        // return home
+                        const Index i = Index(rng() % _cluster.vm_demand.size());
+                        const Index home = _cluster.vm_host[i];
+                        if (state.host[i] != home && state.count[home] > 0 && state.fits(i,home)) {
+                            state.move(i,home);
+                            idle = 0;
+                        }
+                    } else if (move == 1) {
+                        // consolidate: a migrated VM of a light host to a fuller one
+                        const Index j = light_host();
+                        Index i = state.head[j];
+                        for (Index k = Index(rng() % std::uint64_t(state.count[j])); k > 0; --k)
+                            i = state.next[i];
+                        if (_cluster.vm_host[i] == j || _cluster.pinned(i))
+                            continue;
+                        const Index c = sampled_fit(i,j);
+                        if (c >= 0 && state.load[c] > state.load[j]) {
+                            const double d = state.delta(i,c);
+                            if (d <= 0.0) {
+                                state.move(i,c);
+                                if (d < 0.0)
+                                    idle = 0;
+                            }
+                        }
+                    } else {
+                        // ruin and recreate: remove all VMs of a light host and the migrated VMs of
+                        // a few other hosts, reinsert them by decreasing demand
+                        const double before = state.objective();
+                        removed.clear();
+                        const Index j = light_host();
+                        if (_pinned_count[j] == 0)
+                            for (Index i = state.head[j]; i >= 0; i = state.next[i])
+                                removed.emplace_back(std::int32_t(i), std::int32_t(j));
+                        for (int k = 0; k < RuinHosts; ++k) {
+                            const Index c = random_active();
+                            if (c != j)
+                                for (Index i = state.head[c]; i >= 0; i = state.next[i])
+                                    if (_cluster.vm_host[i] != c && !_cluster.pinned(i))
+                                        removed.emplace_back(std::int32_t(i), std::int32_t(c));
+                        }
+                        if (removed.empty())
+                            continue;
+                        std::sort(removed.begin(), removed.end());
+                        removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+                        std::sort(removed.begin(), removed.end(), [this](const auto& a, const auto& b) {
+                            return _cluster.vm_demand[a.first] > _cluster.vm_demand[b.first];
+                        });
+                        for (const auto& [i, from] : removed)
+                            state.unassign(i);
+
+                        // emptied hosts are inactive now, so VMs only go to hosts still in use
+                        std::size_t placed = 0;
+                        for (const auto& [i, from] : removed) {
+                            const Index home = _cluster.vm_host[i];
+                            Index c = state.count[home] > 0 && state.fits(i,home) ? home : sampled_fit(i);
+                            if (c < 0)
+                                c = state.first_fit(i);
+                            if (c < 0)
+                                break;
+                            state.assign(i,c);
+                            ++placed;
+                        }
+                        const double after = state.objective();
+                        if (placed == removed.size() && after <= before) {
+                            if (after < before)
+                                idle = 0;
+                        } else {
+                            for (std::size_t k = 0; k < placed; ++k)
+                                state.unassign(removed[k].first);
+                            for (const auto& [i, from] : removed)
+                                state.assign(i, from);
+                        }
+                    }
+                }
+                return iteration;
+            }
+    };
+
+}
+
+#endif
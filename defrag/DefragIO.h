@@ -0,0 +1,167 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DefragIO_h
+#define _DefragIO_h
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "Defrag.h"
+#include "../binaryIO/binaryIO.h"
+
+namespace Defrag {
+
+     /** Cluster snapshot file.
+       *
+       *  All fields are written in the native endianness of the writer, which is recorded by
+       *  the endian tag (0x0102), so any reader can detect and swap it.
+       *
+       *  +--------------------------------------------------------------------------+
+       *  |  0 | char[4]  | "DFRG"                                                   |
+       *  |  4 | uint16   | version                                                  |
+       *  |  6 | uint16   | endian tag                                               |
+       *  |  8 | uint8    | capacity and demand type code ('d' double, 'f' float)    |
+       *  |  9 | uint8[7] | reserved (zero)                                          |
+       *  | 16 | uint64   | m, number of hosts                                       |
+       *  | 24 | uint64   | n, number of VMs                                         |
+       *  | 32 | uint64   | g, number of anti-affinity groups                        |
+       *  | 40 | uint64   | s, total size of anti-affinity groups                    |
+       *  | 48 | Scalar   | m host capacities                                        |
+       *  |    | uint8    | m host notMig flags                                      |
+       *  |    | Scalar   | n VM demands                                             |
+       *  |    | int32    | n VM original hosts                                      |
+       *  |    | uint8    | n VM migration permissions (b_i)                         |
+       *  |    | uint8    | n VM unMig flags                                         |
+       *  |    | uint64   | g+1 group offsets                                        |
+       *  |    | int32    | s group VMs                                              |
+       *  +--------------------------------------------------------------------------+
+       */
+
+    constexpr std::uint16_t SnapshotVersion = 1;
+    constexpr std::uint16_t SnapshotEndianTag = 0x0102;
+
+    template<typename T> constexpr std::uint8_t SnapshotTypeCode = 0;
+    template<> constexpr std::uint8_t SnapshotTypeCode<double> = 'd';
+    template<> constexpr std::uint8_t SnapshotTypeCode<float> = 'f';
+
+    namespace internal {
+
+        struct SnapshotHeader
+        {
+            char magic[4];
+            std::uint16_t version;
+            std::uint16_t endian;
+            std::uint8_t scalar;
+            std::uint8_t reserved[7];
+            std::uint64_t num_hosts;
+            std::uint64_t num_vms;
+            std::uint64_t num_groups;
+            std::uint64_t num_group_vms;
+        };
+        static_assert(sizeof(SnapshotHeader) == 48);
+
+        template<typename T>
+        inline void ReadArray(binIO::BinaryFile<binIO::Read>& file, std::vector<T>& out, const std::size_t n, const bool swap)
+        {
+            out.resize(n);
+            if (swap)
+                file.read<std::endian::native == std::endian::little ? std::endian::big : std::endian::little>(out.data(), n);
+            else
+                file.read(reinterpret_cast<char*>(out.data()), std::streamsize(n*sizeof(T)));
+        }
+
+        // read "n" values stored as "Source" into "out"
+        template<typename Target, typename Source>
+        inline void ReadArray(binIO::BinaryFile<binIO::Read>& file, std::vector<Target>& out, const std::size_t n, const bool swap)
+        {
+            if constexpr (std::is_same_v<Target,Source>) {
+                ReadArray(file, out, n, swap);
+            } else {
+                std::vector<Source> buffer;
+                ReadArray(file, buffer, n, swap);
+                out.assign(buffer.begin(), buffer.end());
+            }
+        }
+    }
+
+    // Save cluster snapshot
+    template<typename _Scalar>
+    inline void save(const std::filesystem::path& path, const Cluster<_Scalar>& cluster)
+    {
+        static_assert(SnapshotTypeCode<_Scalar> != 0, "Only double and float snapshots can be written.");
+        cluster.check();
+        internal::SnapshotHeader header{{'D','F','R','G'}, SnapshotVersion, SnapshotEndianTag, SnapshotTypeCode<_Scalar>, {},
+                                        std::uint64_t(cluster.num_hosts()), std::uint64_t(cluster.num_vms()),
+                                        std::uint64_t(cluster.num_groups()), std::uint64_t(cluster.group_vms.size())};
+        binIO::BinaryFile<binIO::Write|binIO::Truncate> file(path);
+        file.write(header);
+        file.write(cluster.host_capacity.data(), cluster.host_capacity.size());
+        file.write(cluster.host_closed.data(), cluster.host_closed.size());
+        file.write(cluster.vm_demand.data(), cluster.vm_demand.size());
+        file.write(cluster.vm_host.data(), cluster.vm_host.size());
+        file.write(cluster.vm_allowed.data(), cluster.vm_allowed.size());
+        file.write(cluster.vm_unmig.data(), cluster.vm_unmig.size());
+        file.write(cluster.group_offsets.data(), cluster.group_offsets.size());
+        file.write(cluster.group_vms.data(), cluster.group_vms.size());
+    }
+
+    // Load cluster snapshot (capacities and demands are converted to _Scalar if needed)
+    template<typename _Scalar>
+    inline void load(const std::filesystem::path& path, Cluster<_Scalar>& cluster)
+    {
+        binIO::BinaryFile<binIO::Read> file(path);
+        internal::SnapshotHeader header = file.read<internal::SnapshotHeader>();
+        if (std::memcmp(header.magic, "DFRG", 4) != 0)
+            throw std::runtime_error("Invalid cluster snapshot: " + path.generic_string());
+        const bool swap = header.endian != SnapshotEndianTag;
+        if (swap) {
+            if (reverseBytes(header.endian) != SnapshotEndianTag)
+                throw std::runtime_error("Invalid cluster snapshot endian tag");
+            header.version = reverseBytes(header.version);
+            header.num_hosts = reverseBytes(header.num_hosts);
+            header.num_vms = reverseBytes(header.num_vms);
+            header.num_groups = reverseBytes(header.num_groups);
+            header.num_group_vms = reverseBytes(header.num_group_vms);
+        }
+        if (header.version != SnapshotVersion)
+            throw std::runtime_error("Unsupported cluster snapshot version: " + std::to_string(header.version));
+
+        auto read_scalars = [&](std::vector<_Scalar>& out, const std::size_t n) {
+            switch (header.scalar) {
+                case 'd': internal::ReadArray<_Scalar,double>(file, out, n, swap); break;
+                case 'f': internal::ReadArray<_Scalar,float>(file, out, n, swap); break;
+                default: throw std::runtime_error("Unknown cluster snapshot type code: " + std::to_string(int(header.scalar)));
+            }
+        };
+        read_scalars(cluster.host_capacity, header.num_hosts);
+        internal::ReadArray(file, cluster.host_closed, header.num_hosts, swap);
+        read_scalars(cluster.vm_demand, header.num_vms);
+        internal::ReadArray(file, cluster.vm_host, header.num_vms, swap);
+        internal::ReadArray(file, cluster.vm_allowed, header.num_vms, swap);
+        internal::ReadArray(file, cluster.vm_unmig, header.num_vms, swap);
+        internal::ReadArray(file, cluster.group_offsets, header.num_groups + 1, swap);
+        internal::ReadArray(file, cluster.group_vms, header.num_group_vms, swap);
+        cluster.check();
+    }
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Defrag.h"
+#include "DefragIO.h"
+
+// Defragmentation benchmarks on random clusters, round tripped through a snapshot file. Every plan
+// is scored from scratch by Defrag::score. Results are written as CSV (default) or JSON lines:
+//   vms, hosts, variant, threads, time_limit, seconds, objective, active_hosts, migrations, feasible, lower_bound
+//
+// Usage: bench_defrag [--max-vms N] [--alpha a] [--json] [--output file]
+
+namespace {
+
+    typedef Defrag::Index Index;
+
+    struct Options
+    {
+        Index max_vms = 100000;
+        double alpha = 10.0;
+        bool json = false;
+        std::string output;
+    };
+
+    class Report
+    {
+        public:
+            Report(std::ostream& out, bool json) : _out(out), _json(json)
+            {
+                if (!_json)
+                    _out << "vms,hosts,variant,threads,time_limit,seconds,objective,active_hosts,migrations,feasible,lower_bound" << std::endl;
+            }
+
+            void operator()(Index vms, Index hosts, const std::string& variant, unsigned int threads, double time_limit,
+                    double seconds, const Defrag::Score& score, double lower_bound)
+            {
+                if (_json)
+                    _out << "{\"vms\": " << vms << ", \"hosts\": " << hosts << ", \"variant\": \"" << variant
+                         << "\", \"threads\": " << threads << ", \"time_limit\": " << time_limit << ", \"seconds\": " << seconds
+                         << ", \"objective\": " << score.objective << ", \"active_hosts\": " << score.active_hosts
+                         << ", \"migrations\": " << score.migrations << ", \"feasible\": " << (score.feasible ? "true" : "false")
+                         << ", \"lower_bound\": " << lower_bound << "}" << std::endl;
+                else
+                    _out << vms << "," << hosts << "," << variant << "," << threads << "," << time_limit << "," << seconds << ","
+                         << score.objective << "," << score.active_hosts << "," << score.migrations << "," << score.feasible << ","
+                         << lower_bound << std::endl;
+            }
+
+        private:
+            std::ostream& _out;
+            bool _json;
+    };
+
+    // wall time of f() in seconds
+    template<typename Function>
+    double Seconds(Function&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // n VMs (demands 1 to 16 cores) spread over hosts of 32, 64 and 96 cores filled to about 45%;
+    // 1% of hosts closed, 2% of VMs unMig, 1% not allowed to migrate, anti-affinity groups of 2 to 5
+    // migratable VMs covering about 10% of VMs
+    Defrag::Cluster<double> RandomCluster(const Index n)
+    {
+        std::mt19937 gen(2024);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        const double demands[] = {1, 1, 2, 2, 2, 4, 4, 8, 16};
+        const double capacities[] = {32, 64, 64, 96};
+
+        std::vector<double> demand(n);
+        double total = 0.0;
+        for (double& d : demand)
+            total += d = demands[gen() % std::size(demands)];
+
+        Defrag::Cluster<double> cluster;
+        double capacity = 0.0;
+        while (capacity < total/0.45) {
+            const double c = capacities[gen() % std::size(capacities)];
+            cluster.add_host(c, uniform(gen) < 0.01);
+            capacity += c;
+        }
+        const Index m = cluster.num_hosts();
+
+        std::vector<double> load(m, 0.0);
+        for (Index i = 0; i < n; ++i) {
+            Index j = Index(gen() % m);
+            while (load[j] + demand[i] > cluster.host_capacity[j])
+                j = (j + 1) % m;
+            load[j] += demand[i];
+            const double r = cluster.host_closed[j] ? 1.0 : uniform(gen);
+            cluster.add_vm(demand[i], j, !(r < 0.01), r >= 0.01 && r < 0.03);
+        }
+
+        std::vector<int> group;
+        for (Index k = 0; k < n/35; ++k) {
+            group.clear();
+            for (Index size = 2 + Index(gen() % 4); Index(group.size()) < size; ) {
+                const int i = int(gen() % n);
+                if (!cluster.pinned(i) && std::find(group.begin(), group.end(), i) == group.end())
+                    group.push_back(i);
+            }
+            cluster.add_group(group);
+        }
+        return cluster;
+    }
+
+    // alpha times the least number of hosts able to hold all demand (largest open hosts first) and
+    // no less than the hosts of pinned VMs
+    double LowerBound(const Defrag::Cluster<double>& cluster, const double alpha)
+    {
+        std::vector<double> capacity;
+        for (Index j = 0; j < cluster.num_hosts(); ++j)
+            if (!cluster.host_closed[j])
+                capacity.push_back(cluster.host_capacity[j]);
+        std::sort(capacity.begin(), capacity.end(), std::greater<double>());
+        double total = 0.0;
+        std::vector<std::uint8_t> pinned(cluster.num_hosts(), 0);
+        for (Index i = 0; i < cluster.num_vms(); ++i) {
+            total += cluster.vm_demand[i];
+            if (cluster.pinned(i))
+                pinned[cluster.vm_host[i]] = 1;
+        }
+        Index hosts = 0;
+        for (double sum = 0.0; sum < total && hosts < Index(capacity.size()); ++hosts)
+            sum += capacity[hosts];
+        return alpha*double(std::max(hosts, Index(std::count(pinned.begin(), pinned.end(), 1))));
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--max-vms") && i + 1 < argc)
+            options.max_vms = std::stol(argv[++i]);
+        else if (!std::strcmp(argv[i], "--alpha") && i + 1 < argc)
+            options.alpha = std::stod(argv[++i]);
+        else if (!std::strcmp(argv[i], "--json"))
+            options.json = true;
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+            options.output = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--max-vms N] [--alpha a] [--json] [--output file]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty())
+        file.open(options.output);
+    Report report(options.output.empty() ? std::cout : file, options.json);
+
+    const std::filesystem::path snapshot = std::filesystem::temp_directory_path() / "bench_defrag_cluster.bin";
+    const unsigned int all_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (Index n = 1000; n <= options.max_vms; n *= 10) {
+        Defrag::save(snapshot, RandomCluster(n));
+        Defrag::Cluster<double> cluster;
+        const double load_seconds = Seconds([&]() { Defrag::load(snapshot, cluster); });
+        const Index m = cluster.num_hosts();
+        const double bound = LowerBound(cluster, options.alpha);
+
+        const Defrag::Score original = Defrag::score(cluster, cluster.vm_host, options.alpha);
+        report(n, m, "original", 0, 0.0, load_seconds, original, bound);
+
+        Defrag::Options solver_options;
+        solver_options.alpha = options.alpha;
+        Defrag::Plan plan;
+        double seconds = Seconds([&]() { plan = Defrag::Solver<double>(cluster, solver_options).repaired(); });
+        report(n, m, "repaired", 1, 0.0, seconds, Defrag::score(cluster, plan.host, options.alpha), bound);
+        seconds = Seconds([&]() { plan = Defrag::Solver<double>(cluster, solver_options).first_fit_decreasing(); });
+        report(n, m, "first_fit_decreasing", 1, 0.0, seconds, Defrag::score(cluster, plan.host, options.alpha), bound);
+
+        for (const double time_limit : {0.1, 1.0, 5.0})
+            for (unsigned int threads = 1; threads <= all_threads; threads = threads < all_threads ? all_threads : threads + 1) {
+                solver_options.time_limit = time_limit;
+                solver_options.num_threads = threads;
+                seconds = Seconds([&]() { plan = Defrag::Solver<double>(cluster, solver_options).solve(); });
+                report(n, m, "local_search", threads, time_limit, seconds, Defrag::score(cluster, plan.host, options.alpha), bound);
+            }
+    }
+    std::filesystem::remove(snapshot);
+}
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <vector>
+#include "Defrag.h"
+#include "DefragIO.h"
+
+void print(const char* name, const Defrag::Plan& plan)
+{
+  std::cout << name << ": objective " << plan.score.objective << ", active hosts " << plan.score.active_hosts
+            << ", migrations " << plan.score.migrations << ", feasible " << plan.score.feasible << std::endl;
+  std::cout << "  hosts of VMs: [";
+  for (const auto j : plan.host)
+    std::cout << " " << j;
+  std::cout << " ]" << std::endl;
+}
+
+int main()
+{
+  // 6 hosts of 16 cores, 12 VMs spread over them
+  Defrag::Cluster<double> cluster;
+  for (int j = 0; j < 6; ++j)
+    cluster.add_host(16.0, j == 5);                                   //host 5 in notMig
+  const double demand[] = {8, 4, 4, 2, 6, 2, 8, 2, 1, 4, 2, 2};
+  const int host[] = {0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+  for (int i = 0; i < 12; ++i)
+    cluster.add_vm(demand[i], host[i], i != 6, i == 0);                 //VM 6 not allowed to migrate, VM 0 in unMig
+  cluster.add_group(std::vector<int>{0, 2, 4});                        //anti-affinity
+  cluster.add_group(std::vector<int>{6, 9});
+
+  Defrag::Options options;
+  options.alpha = 10.0;
+  options.time_limit = 0.1;
+
+  const Defrag::Plan original{std::vector<std::int32_t>(host, host + 12), Defrag::score(cluster, std::vector<std::int32_t>(host, host + 12), options.alpha)};
+  print("Original placement", original);
+
+  Defrag::Solver<double> solver(cluster, options);
+  print("First fit decreasing", solver.first_fit_decreasing());
+  print("Repaired original placement", solver.repaired());
+  print("Local search", solver.solve());
+
+  Defrag::save("cluster.bin", cluster);
+  Defrag::Cluster<float> loaded;
+  Defrag::load("cluster.bin", loaded);
+  print("Local search (snapshot loaded as float)", Defrag::Solver<float>(loaded, options).solve());
+}
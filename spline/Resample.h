@@ -0,0 +1,303 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _Resample_h
+#define _Resample_h
+
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Spline1D.h"
+#include "../binaryIO/binaryIO.h"
+
+namespace Spline {
+
+     /** Streaming resampling of (x,y) sample files.
+       *
+       *  Input and output files are sequences of (x,y) pairs of Scalar in "en" byte order, x strictly
+       *  increasing. Output x values are the uniform grid x0 + k*step, k = 0,1,..., over the samples
+       *  range, x0 being the first sample x.
+       *
+       *  Stages, connected by bounded queues of recycled buffers (memory use doesn't depend on file size):
+       *
+       *    read thread:   chunk_size samples from file, endian conversion, split into x and y
+       *    calling thread: local spline fit of each chunk, batch evaluation on its grid points
+       *    write thread:  interleave grid x and spline values, endian conversion, write to file
+       *
+       *  Each chunk is fitted with "overlap" samples of the neighbouring chunks on both sides, and the
+       *  spline is evaluated only between the chunk first sample and the next chunk first one. The
+       *  natural boundary conditions of a local fit perturb the second derivatives by a factor about
+       *  (2-sqrt(3))^k ~ 0.27^k at k intervals from the window end (quasi uniform samples), so with the
+       *  default overlap of 32 samples the result matches the global spline fit to roundoff.
+       */
+    struct ResampleOptions
+    {
+        Eigen::Index chunk_size = Eigen::Index(1) << 16;    // samples per chunk (also grid points per output chunk), at least overlap
+        Eigen::Index overlap = 32;                          // samples of neighbouring chunks in each local fit (at least 1)
+        Eigen::Index queue_depth = 4;                       // chunks in flight between two stages
+        unsigned int num_threads = 0;                       // threads of batch evaluation (0: all cores)
+    };
+
+    namespace internal {
+
+        // bounded FIFO between pipeline stages; close() wakes up all waiting threads
+        template<typename T>
+        class BoundedQueue
+        {
+            public:
+                explicit BoundedQueue(const std::size_t capacity) : _capacity(capacity), _closed(false) {}
+
+                // false if the queue was closed
+                inline bool push(const T& value)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _not_full.wait(lock, [this]() { return _closed || _queue.size() < _capacity; });
+                    if (_closed)
+                        return false;
+                    _queue.push_back(value);
+                    _not_empty.notify_one();
+                    return true;
+                }
+
+                // false if the queue was closed and is empty
+                inline bool pop(T& value)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _not_empty.wait(lock, [this]() { return _closed || !_queue.empty(); });
+                    if (_queue.empty())
+                        return false;
+                    value = _queue.front();
+                    _queue.pop_front();
+                    _not_full.notify_one();
+                    return true;
+                }
+
+                inline void close()
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _closed = true;
+                    _not_empty.notify_all();
+                    _not_full.notify_all();
+                }
+
+            private:
+                const std::size_t _capacity;
+                bool _closed;
+                std::deque<T> _queue;
+                std::mutex _mutex;
+                std::condition_variable _not_empty, _not_full;
+        };
+
+    }
+
+    // resample file "input" of Scalar samples on a uniform grid of spacing "step" into file "output",
+    // returns number of grid points (Scalar is explicit: the file type must not follow the step type)
+    template<typename Scalar, std::endian en = std::endian::big>
+    Eigen::Index resample(const std::filesystem::path& input, const std::filesystem::path& output,
+            const std::type_identity_t<Scalar> step, const ResampleOptions& options = ResampleOptions())
+    {
+        typedef Eigen::Array<Scalar,Eigen::Dynamic,1> Vector;
+        static_assert(std::is_floating_point_v<Scalar>, "Resampling needs floating point samples.");
+        if (!(step > Scalar(0.0)))
+            throw std::runtime_error("Resampling grid step must be positive.");
+
+        binIO::BinaryFile<binIO::Read> in(input);
+        const std::uintmax_t file_size = std::filesystem::file_size(input);
+        if (file_size % (2*sizeof(Scalar)) != 0)
+            throw std::runtime_error("Sample file size is not a whole number of (x,y) pairs: " + input.generic_string());
+        const Eigen::Index num_samples = Eigen::Index(file_size / (2*sizeof(Scalar)));
+        if (num_samples < 2)
+            throw std::runtime_error("Resampling needs at least 2 samples: " + input.generic_string());
+        binIO::BinaryFile<binIO::Write> out(output);
+
+        // at least one sample of each neighbour: grid points between two chunks are then interpolated, and
+        // every local fit has 2 points or more (a 1-sample tail chunk gets the previous chunk last samples).
+        // Chunks hold at least "overlap" samples, so that a neighbour chunk provides all overlap samples (only
+        // the last chunk can be shorter, and then its end is the end of data, as for a global fit)
+        const Eigen::Index chunk_size = std::clamp(std::max(options.chunk_size, options.overlap), Eigen::Index(2), num_samples);
+        const Eigen::Index overlap = std::clamp(options.overlap, Eigen::Index(1), chunk_size);
+        const std::size_t depth = std::size_t(std::max(options.queue_depth, Eigen::Index(1)));
+
+        // sample chunks: the fit stage holds three (previous, current and next) besides the queued ones
+        struct Samples { Vector x, y; Eigen::Index size; };
+        std::vector<Samples> samples(depth + 4);
+        for (Samples& chunk : samples)
+            chunk.x.resize(chunk_size), chunk.y.resize(chunk_size);
+        // grid chunks: values at grid points first..first+size-1
+        struct Values { Vector y; Eigen::Index first, size; };
+        std::vector<Values> values(depth + 2);
+        for (Values& chunk : values)
+            chunk.y.resize(chunk_size);
+
+        internal::BoundedQueue<std::size_t> free_samples(samples.size()), read_samples(depth);
+        internal::BoundedQueue<std::size_t> free_values(values.size()), fitted_values(depth);
+        for (std::size_t i = 0; i < samples.size(); ++i)
+            free_samples.push(i);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            free_values.push(i);
+
+        // grid origin, set by the fit stage before the first values are queued
+        Scalar x0 = Scalar(0.0);
+        auto grid = [&](const Eigen::Index k) { return x0 + Scalar(k)*step; };
+
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        auto fail = [&]() {
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+            free_samples.close();
+            read_samples.close();
+            free_values.close();
+            fitted_values.close();
+        };
+
+        std::thread reader([&]() {
+            try {
+                std::vector<Scalar> raw(2*chunk_size);
+                std::size_t i;
+                for (Eigen::Index s0 = 0; s0 < num_samples && free_samples.pop(i); s0 += chunk_size) {
+                    Samples& chunk = samples[i];
+                    chunk.size = std::min(chunk_size, num_samples - s0);
+                    in.read<en>(raw.data(), std::size_t(2*chunk.size));
+                    for (Eigen::Index j = 0; j < chunk.size; ++j) {
+                        chunk.x(j) = raw[2*j];
+                        chunk.y(j) = raw[2*j+1];
+                    }
+                    if (!read_samples.push(i))
+                        break;
+                }
+                read_samples.close();
+            } catch (...) {
+                fail();
+            }
+        });
+
+        std::thread writer([&]() {
+            try {
+                std::vector<Scalar> raw(2*chunk_size);
+                std::size_t i;
+                while (fitted_values.pop(i)) {
+                    const Values& chunk = values[i];
+                    for (Eigen::Index j = 0; j < chunk.size; ++j) {
+                        raw[2*j] = grid(chunk.first + j);
+                        raw[2*j+1] = chunk.y(j);
+                    }
+                    out.write<en>(raw.data(), std::size_t(2*chunk.size));
+                    if (!free_values.push(i))
+                        break;
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+
+        // fit stage
+        Eigen::Index num_points = 0;
+        try {
+            Spline<Scalar> spline;
+            Vector x(chunk_size + 2*overlap), y(chunk_size + 2*overlap);
+            std::size_t prev = 0, cur = 0, next = 0;
+            bool has_prev = false, has_cur = false;
+
+            // fit chunk "cur" with neighbours' overlap samples and evaluate it on its grid points
+            auto process = [&](const bool has_next) {
+                const Samples& chunk = samples[cur];
+                Eigen::Index m = 0;
+                if (has_prev) {
+                    const Samples& p = samples[prev];
+                    const Eigen::Index t = std::min(overlap, p.size);
+                    x.segment(m,t) = p.x.segment(p.size-t,t);
+                    y.segment(m,t) = p.y.segment(p.size-t,t);
+                    m += t;
+                }
+                x.segment(m,chunk.size) = chunk.x.head(chunk.size);
+                y.segment(m,chunk.size) = chunk.y.head(chunk.size);
+                m += chunk.size;
+                if (has_next) {
+                    const Samples& n = samples[next];
+                    const Eigen::Index t = std::min(overlap, n.size);
+                    x.segment(m,t) = n.x.head(t);
+                    y.segment(m,t) = n.y.head(t);
+                    m += t;
+                }
+                assert(m >= 2);
+                spline.set(x.head(m), y.head(m));
+
+                // grid points up to the next chunk first sample (excluded) or the last sample (included)
+                const Eigen::Index k1 = has_next ? Eigen::Index(std::ceil((samples[next].x(0) - x0)/step))
+                                                 : Eigen::Index(std::floor((chunk.x(chunk.size-1) - x0)/step)) + 1;
+                std::size_t i;
+                while (num_points < k1) {
+                    if (!free_values.pop(i))
+                        return false;
+                    Values& v = values[i];
+                    v.first = num_points;
+                    v.size = std::min(chunk_size, k1 - num_points);
+                    spline.evaluate(Vector::NullaryExpr(v.size, [&](const Eigen::Index j) { return grid(v.first + j); }),
+                            v.y.data(), options.num_threads);
+                    num_points += v.size;
+                    if (!fitted_values.push(i))
+                        return false;
+                }
+                return true;
+            };
+
+            std::size_t i;
+            bool ok = true;
+            while (ok && read_samples.pop(i)) {
+                if (!has_cur) {
+                    cur = i;
+                    has_cur = true;
+                    x0 = samples[cur].x(0);
+                    continue;
+                }
+                next = i;
+                ok = process(true);
+                if (has_prev)
+                    free_samples.push(prev);
+                prev = cur;
+                has_prev = true;
+                cur = next;
+            }
+            if (ok && has_cur)
+                process(false);
+            fitted_values.close();
+        } catch (...) {
+            fail();
+        }
+        reader.join();
+        writer.join();
+        if (error)
+            std::rethrow_exception(error);
+        return num_points;
+    }
+
+}
+
+#endif
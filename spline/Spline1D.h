@@ -21,6 +21,15 @@
 
 #include <Eigen/Dense>
 #include <math.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace Spline {
 
@@ -40,7 +49,7 @@ namespace Spline {
             inline static const CriticalPointArray Zero() { return CriticalPointArray(); }
             inline void setZero() { (*this) = Zero(); }
 
-            inline bool full() const { return _length < Size; }
+            inline bool full() const { return _length == Size; }
             inline Eigen::Index size() const { return _length; }
             inline Eigen::Index& size() { return _length; }
             inline const Scalar x(Eigen::Index i) const { return _array(i); }
@@ -96,7 +105,181 @@ namespace Spline {
             Eigen::Index _length;
     };
 
-    template <typename _Scalar, int _Size = Eigen::Dynamic>
+    // Critical points array with capacity set at runtime. Points are kept in a min-heap
+    // (by y value) while saving, so each Save costs O(log capacity); Sort() must be
+    // called before accessing the points, which are then ordered by descending y value.
+    template<typename _T>
+    struct CriticalPointArray<_T,Eigen::Dynamic>
+    {
+        public:
+            typedef _T Scalar;
+            enum { Size = Eigen::Dynamic };
+            typedef Eigen::Array<Scalar,Eigen::Dynamic,1> PointArray;
+
+            CriticalPointArray() : CriticalPointArray(Eigen::Index(0)) {}
+            explicit CriticalPointArray(const Eigen::Index capacity)
+            : _array(PointArray::Zero(2*capacity)), _capacity(capacity), _length(Eigen::Index(0)), _heap()
+            {
+                _heap.reserve(capacity);
+            }
+
+            inline void setZero() { _array.setZero(); _length = 0; _heap.clear(); }
+
+            inline Eigen::Index capacity() const { return _capacity; }
+            inline bool full() const { return Eigen::Index(_heap.size()) == _capacity; }
+            inline Eigen::Index size() const { return _length; }
+            inline const Scalar x(Eigen::Index i) const { return _array(i); }
+            inline const Scalar y(Eigen::Index i) const { return _array(i+_capacity); }
+            inline decltype(auto) x() const { return _array.segment(0,_length); }
+            inline decltype(auto) y() const { return _array.segment(_capacity,_length); }
+
+            friend std::ostream& operator<<(std::ostream& out, const CriticalPointArray& _array)
+            {
+                for (Eigen::Index i=0; i < _array.size(); ++i )
+                    out << _array.x(i) << " " << _array.y(i) << std::endl;
+                return out;
+            }
+
+            inline void Save(const Scalar& x, const Scalar& y)
+            {
+                if (Eigen::Index(_heap.size()) < _capacity) {
+                    _heap.emplace_back(y,x);
+                    std::push_heap(_heap.begin(), _heap.end(), std::greater<Point>());
+                } else if (_capacity > 0 && _heap.front().first < y) {
+                    std::pop_heap(_heap.begin(), _heap.end(), std::greater<Point>());
+                    _heap.back() = Point(y,x);
+                    std::push_heap(_heap.begin(), _heap.end(), std::greater<Point>());
+                }
+            }
+
+            // save not yet sorted points of other array
+            inline void Merge(const CriticalPointArray& other)
+            {
+                for (const Point& p : other._heap)
+                    Save(p.second, p.first);
+            }
+
+            inline void Sort()
+            {
+                std::vector<Point> points(_heap);
+                std::sort(points.begin(), points.end(), std::greater<Point>());
+                _length = Eigen::Index(points.size());
+                for (Eigen::Index i = 0; i < _length; ++i) {
+                    _array(i)           = points[i].second;
+                    _array(i+_capacity) = points[i].first;
+                }
+            }
+
+        private:
+            typedef std::pair<Scalar,Scalar> Point;     // (y, x)
+
+            PointArray _array;
+            Eigen::Index _capacity;
+            Eigen::Index _length;
+            std::vector<Point> _heap;
+    };
+
+    // All local maxima, minima (including break points at boundaries) and inflection points
+    // of a spline, ordered by x. Each array has two columns: x and y coordinates.
+    template<typename _T>
+    struct CriticalPoints
+    {
+        typedef _T Scalar;
+        typedef Eigen::Array<Scalar,Eigen::Dynamic,2> PointList;
+
+        PointList maxima;
+        PointList minima;
+        PointList inflections;
+    };
+
+    // Spline storage layout policies.
+    //
+    // SoALayout: break points and each of the four coefficient columns are stored in separate
+    // arrays (column-major). Best for batch and vectorized paths.
+    struct SoALayout
+    {
+        template<typename _T, typename _C, int _Size> struct Storage {};
+    };
+
+    // InterleavedLayout: in addition to SoA arrays (still used by batch and vectorized paths),
+    // keeps one record per interval with break point and four coefficients, padded to a power
+    // of two (32 bytes for float, 64 bytes for double), so point evaluation touches a single
+    // cache line per interval. Coefficient memory is doubled.
+    struct InterleavedLayout
+    {
+        template<typename _T, typename _C = _T>
+        struct alignas(std::bit_ceil(sizeof(_T)+4*sizeof(_C))) Record
+        {
+            _T x;
+            _C c[4];
+        };
+
+        template<typename _T, typename _C, int _Size>
+        struct Storage
+        {
+            typedef std::conditional_t<_Size == Eigen::Dynamic,
+                    std::vector<Record<_T,_C>>, std::array<Record<_T,_C>,std::max(_Size,0)>> Records;
+            Records records;
+        };
+    };
+
+    // many dynamic size splines in one arena (SplinePool.h)
+    template<typename _Scalar, typename _Coeff = _Scalar> class SplinePool;
+
+    // Non-owning read-only view of a fitted spline stored elsewhere (memory mapped file, pool arena...):
+    // "num_breaks" break points followed (at "coeffs") by the (num_breaks-1)x4 column-major coefficients.
+    template<typename _Scalar, typename _Coeff = _Scalar>
+    class SplineView
+    {
+        public:
+            typedef _Scalar Scalar;
+            typedef _Coeff CoeffScalar;
+
+            SplineView() : _num_breaks(0), _breaks(nullptr), _coeffs(nullptr) {}
+            SplineView(const Scalar* breaks, const CoeffScalar* coeffs, const Eigen::Index num_breaks)
+            : _num_breaks(num_breaks), _breaks(breaks), _coeffs(coeffs) {}
+
+            inline Eigen::Index num_breaks() const { return _num_breaks; }
+            inline decltype(auto) breaks() const
+            {
+                return Eigen::Map<const Eigen::Array<Scalar,Eigen::Dynamic,1>>(_breaks,_num_breaks);
+            }
+            inline decltype(auto) coefs() const
+            {
+                return Eigen::Map<const Eigen::Array<CoeffScalar,Eigen::Dynamic,4>>(_coeffs,_num_breaks-1,4);
+            }
+
+            inline Scalar operator()(const Scalar x) const
+            {
+                const Scalar* pos = std::upper_bound(_breaks+1, _breaks+_num_breaks-1, x);
+                return (*this)(x, Eigen::Index(std::distance(_breaks,pos)) - Eigen::Index(1));
+            }
+
+            inline Scalar operator()(const Scalar x, const Eigen::Index& it) const
+            {
+                const Eigen::Index stride = _num_breaks - 1;
+                const Scalar h = x - _breaks[it];
+                return ((Scalar(_coeffs[it])*h+Scalar(_coeffs[it+stride]))*h+Scalar(_coeffs[it+2*stride]))*h+Scalar(_coeffs[it+3*stride]);
+            }
+
+        private:
+            Eigen::Index _num_breaks;
+            const Scalar* _breaks;
+            const CoeffScalar* _coeffs;
+    };
+
+    // Natural cubic spline.
+    //
+    // _Scalar is the type of break points, queries and evaluation; _Coeff is the coefficient storage
+    // type (ex.: float, Eigen::half or Eigen::bfloat16 with double or float _Scalar). The system is
+    // solved with the precision of the interpolation points when it is higher than the storage one
+    // (ex.: double points into Spline<float>) on the break points rounded to _Scalar, and coefficients
+    // are rounded once to _Coeff. With u the unit roundoff of _Coeff (2^-24 float, 2^-11 half, 2^-8
+    // bfloat16), the stored polynomial of an interval of length h deviates from the fitted one by at
+    // most u*(|a|h^3+|b|h^2+|c|h+|d|), which is about u*max|y| for well resolved data. Rounding break
+    // points and queries to _Scalar (unit roundoff u_s) adds about u_s*max|x|*max|S'| against a fit and
+    // evaluation at the exact abscissas.
+    template <typename _Scalar, int _Size = Eigen::Dynamic, typename _Layout = SoALayout, typename _Coeff = _Scalar>
     class Spline
     {
         public:
@@ -104,25 +287,55 @@ namespace Spline {
             enum { CoefsSize = BreaksSize == Eigen::Dynamic ? Eigen::Dynamic : BreaksSize - 1 };
 
             typedef _Scalar Scalar;
+            typedef _Layout Layout;
+            typedef _Coeff CoeffScalar;
             typedef Eigen::Array<Scalar,BreaksSize,1> Points;
 
+            // dynamic size splines with at least SearchIndexMinBreaks inner break points build an
+            // Eytzinger ordered copy of break points at fit time for faster interval search
+            static constexpr Eigen::Index SearchIndexMinBreaks = 64;
+
+            // points per block of batch evaluation (queries and results of a block stay in L2 cache)
+            static constexpr Eigen::Index BatchBlockSize = 4096;
+
             template<int _N> using MaximaArray = CriticalPointArray<Scalar,_N>;
+            typedef CriticalPointArray<Scalar,Eigen::Dynamic> DynamicMaximaArray;
 
             // default constructor
-            Spline() : _num_breaks(0), _breaks(), _coeffs() {}
+            Spline() : _num_breaks(0), _breaks(), _coeffs(), _storage(), _integrals(), _integrals_valid(false), _eytzinger(), _eytzinger_rank() {}
 
             // explicit constructor
             template<typename ArrayTypeX, typename ArrayTypeY>
             Spline(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
-            : _num_breaks(), _breaks(), _coeffs()
+            : _num_breaks(), _breaks(), _coeffs(), _storage(), _integrals(), _integrals_valid(false), _eytzinger(), _eytzinger_rank()
             {
                 _AssertSize(x,y);
-                // cast function has no cost if cast to same type
-                _SetSpline(x.template cast<Scalar>(),y.template cast<Scalar>());
+                // points are cast to the fit precision inside _SetSpline
+                _SetSpline(x,y);
             }
 
-            // copy constructor
-            Spline(const Spline& spline) : _num_breaks(spline._num_breaks), _breaks(spline._breaks), _coeffs(spline._coeffs) {}
+            // copy constructor (integrals are copied only if already built, see _Integrals)
+            Spline(const Spline& spline)
+            : _num_breaks(spline._num_breaks), _breaks(spline._breaks), _coeffs(spline._coeffs), _storage(spline._storage),
+              _integrals(), _integrals_valid(false), _eytzinger(spline._eytzinger), _eytzinger_rank(spline._eytzinger_rank)
+            {
+                _CopyIntegrals(spline);
+            }
+
+            Spline& operator=(const Spline& spline)
+            {
+                if (this != &spline) {
+                    _num_breaks = spline._num_breaks;
+                    _breaks = spline._breaks;
+                    _coeffs = spline._coeffs;
+                    _storage = spline._storage;
+                    _eytzinger = spline._eytzinger;
+                    _eytzinger_rank = spline._eytzinger_rank;
+                    _integrals_valid.store(false, std::memory_order_relaxed);
+                    _CopyIntegrals(spline);
+                }
+                return *this;
+            }
 
             ~Spline() {}
 
@@ -131,89 +344,579 @@ namespace Spline {
             inline void set(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
             {
                 _AssertSize(x,y);
-                // cast function has no cost if cast to same type
-                _SetSpline(x.template cast<Scalar>(),y.template cast<Scalar>());
+                // points are cast to the fit precision inside _SetSpline
+                _SetSpline(x,y);
             }
+
+            // set already fitted spline from break points and coefficients (ex.: loaded from file)
+            template<typename ArrayTypeB, typename ArrayTypeC>
+            inline void set_coefs(const Eigen::ArrayBase<ArrayTypeB>& breaks, const Eigen::ArrayBase<ArrayTypeC>& coefs)
+            {
+                assert((breaks.size() > 1) && " Number of break points is less then 2.");
+                assert((coefs.rows() == breaks.size()-1 && coefs.cols() == 4) && "Coefficients array must have size (num_breaks-1)x4.");
+                if constexpr (BreaksSize != Eigen::Dynamic)
+                    assert( (BreaksSize >= breaks.size()) && "Use Spline with Dynamic size. Ex.: Spline<float> Spl(x,y);");
+
+                _num_breaks = breaks.size();
+                _integrals_valid.store(false, std::memory_order_relaxed);
+                if constexpr (BreaksSize == Eigen::Dynamic) {
+                    if (_breaks.size() < breaks.size()) {
+                        _breaks.resize(_num_breaks);
+                        _coeffs.resize(_num_breaks - 1,4);
+                    }
+                }
+                _breaks.head(_num_breaks) = breaks.template cast<Scalar>();
+                _coeffs.topRows(_num_breaks-1) = coefs.template cast<CoeffScalar>();
+                _SetRecords();
+                _SetEytzinger();
+            }
+
             inline int num_breaks() const { return _num_breaks; }
             inline decltype(auto) breaks() const { return _breaks.head(_num_breaks); }
             inline decltype(auto) coefs() const { return _coeffs.topRows(_num_breaks-1); }
-            inline Scalar operator()(Scalar x)
+            // All const members (evaluation, derivatives, integrals, maxima) can be called concurrently on a
+            // shared spline. set() and set_coefs() must not run concurrently with any other member.
+            inline Scalar operator()(const Scalar x) const
             {
-                const Scalar* pos = std::upper_bound(_breaks.data(), _breaks.data()+_num_breaks, x);
-                const Eigen::Index it = std::max(Eigen::Index(std::distance(_breaks.data(),pos))-Eigen::Index(1),Eigen::Index(0)) ;
-                const Scalar h = x - _breaks(it);
-                return ((_coeffs(it,0)*h+_coeffs(it,1))*h+_coeffs(it,2))*h+_coeffs(it,3);
+                const Eigen::Index it = _Interval(x);
+                const Scalar h = x - _Break(it);
+                return ((_Coef(it,0)*h+_Coef(it,1))*h+_Coef(it,2))*h+_Coef(it,3);
             }
 
             inline const Scalar operator()(const Scalar x, const Eigen::Index& it) const
             {
-                const Scalar h = x - _breaks(it);
-                return ((_coeffs(it,0)*h+_coeffs(it,1))*h+_coeffs(it,2))*h+_coeffs(it,3);
+                const Scalar h = x - _Break(it);
+                return ((_Coef(it,0)*h+_Coef(it,1))*h+_Coef(it,2))*h+_Coef(it,3);
+            }
+
+            // Stateful evaluator for monotone or clustered query streams: each query starts the
+            // interval search from the interval of the previous one (see _Hunt).
+            class Hunter
+            {
+                public:
+                    explicit Hunter(const Spline& spline) : _spline(spline), _it(0) {}
+
+                    inline Eigen::Index interval() const { return _it; }
+                    inline Scalar operator()(const Scalar x)
+                    {
+                        _it = _spline._Hunt(x,_it);
+                        return _spline(x,_it);
+                    }
+                    inline Scalar derivative(const Scalar x, const int order = 1)
+                    {
+                        _it = _spline._Hunt(x,_it);
+                        return _spline.derivative(x,order,_it);
+                    }
+
+                private:
+                    const Spline& _spline;
+                    Eigen::Index _it;
+            };
+
+            inline Hunter hunter() const { return Hunter(*this); }
+
+            // evaluation at every point of x, with contiguous ranges of points split among "num_threads" threads
+            template<typename ArrayType>
+            inline Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime>
+            operator()(const Eigen::ArrayBase<ArrayType>& x, const unsigned int num_threads = 0) const
+            {
+                Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime> y(x.rows(),x.cols());
+                evaluate(x, y.data(), num_threads);
+                return y;
+            }
+
+            // evaluation into a preallocated output of x.size() elements. Points are processed in blocks of
+            // BatchBlockSize; sorted blocks (ex.: resampling grids) use interval hunting, others direct search
+            template<typename ArrayType>
+            inline void evaluate(const Eigen::ArrayBase<ArrayType>& x, Scalar* y, unsigned int num_threads = 0) const
+            {
+                assert((_num_breaks > 0) && "To evaluate spline it must be created first with interpolation points.");
+                // don't spawn threads for less than MinPointsPerThread points each
+                constexpr Eigen::Index MinPointsPerThread = Eigen::Index(1) << 15;
+                const Eigen::Index n = x.size();
+                if (num_threads == 0)
+                    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+                num_threads = unsigned(std::clamp(n / MinPointsPerThread, Eigen::Index(1), Eigen::Index(num_threads)));
+
+                if (num_threads == 1) {
+                    _Evaluate(x, y, Eigen::Index(0), n);
+                } else {
+                    // ranges are whole blocks, so threads never share cache lines of y
+                    const Eigen::Index blocks = (n + BatchBlockSize - 1) / BatchBlockSize;
+                    const Eigen::Index chunk = (blocks + num_threads - 1) / num_threads * BatchBlockSize;
+                    std::vector<std::thread> threads;
+                    for (Eigen::Index i0 = chunk; i0 < n; i0 += chunk)
+                        threads.emplace_back([&, i0]() { _Evaluate(x, y, i0, std::min(i0 + chunk, n)); });
+                    _Evaluate(x, y, Eigen::Index(0), std::min(chunk, n));
+                    for (std::thread& thread : threads)
+                        thread.join();
+                }
+            }
+
+            // derivative of given order (order 0 is the spline value, orders above 3 are zero)
+            inline Scalar derivative(const Scalar x, const int order = 1) const
+            {
+                return derivative(x, order, _Interval(x));
+            }
+
+            inline Scalar derivative(const Scalar x, const int order, const Eigen::Index& it) const
+            {
+                assert((order >= 0) && "Derivative order must be non-negative.");
+                const Scalar h = x - _Break(it);
+                switch (order) {
+                    case 0:  return ((_Coef(it,0)*h+_Coef(it,1))*h+_Coef(it,2))*h+_Coef(it,3);
+                    case 1:  return (Scalar(3.0)*_Coef(it,0)*h+Scalar(2.0)*_Coef(it,1))*h+_Coef(it,2);
+                    case 2:  return Scalar(6.0)*_Coef(it,0)*h+Scalar(2.0)*_Coef(it,1);
+                    case 3:  return Scalar(6.0)*_Coef(it,0);
+                    default: return Scalar(0.0);
+                }
+            }
+
+            template<typename ArrayType>
+            inline Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime>
+            derivative(const Eigen::ArrayBase<ArrayType>& x, const int order = 1) const
+            {
+                Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime> d(x.rows(),x.cols());
+                for (Eigen::Index i = 0; i < x.size(); ++i)
+                    d(i) = derivative(Scalar(x(i)), order);
+                return d;
+            }
+
+            // integral of the spline from first break point to x
+            inline Scalar cumulative_integral(const Scalar x) const
+            {
+                const Eigen::Index it = _Interval(x);
+                const Scalar h = x - _Break(it);
+                return _Integrals()(it) + _SegmentIntegral(it,h);
+            }
+
+            template<typename ArrayType>
+            inline Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime>
+            cumulative_integral(const Eigen::ArrayBase<ArrayType>& x) const
+            {
+                Eigen::Array<Scalar,ArrayType::RowsAtCompileTime,ArrayType::ColsAtCompileTime> F(x.rows(),x.cols());
+                for (Eigen::Index i = 0; i < x.size(); ++i)
+                    F(i) = cumulative_integral(Scalar(x(i)));
+                return F;
+            }
+
+            // definite integral over [a,b]
+            inline Scalar integral(const Scalar a, const Scalar b) const
+            {
+                return cumulative_integral(b) - cumulative_integral(a);
+            }
+
+            // integral over the whole break points range
+            inline Scalar integral() const
+            {
+                return _Integrals()(_num_breaks-1);
+            }
+
+            template<typename ArrayTypeA, typename ArrayTypeB>
+            inline Eigen::Array<Scalar,ArrayTypeA::RowsAtCompileTime,ArrayTypeA::ColsAtCompileTime>
+            integral(const Eigen::ArrayBase<ArrayTypeA>& a, const Eigen::ArrayBase<ArrayTypeB>& b) const
+            {
+                assert((a.size() == b.size()) && "Integration limits arrays must have same size.");
+                Eigen::Array<Scalar,ArrayTypeA::RowsAtCompileTime,ArrayTypeA::ColsAtCompileTime> I(a.rows(),a.cols());
+                for (Eigen::Index i = 0; i < a.size(); ++i)
+                    I(i) = integral(Scalar(a(i)), Scalar(b(i)));
+                return I;
             }
 
             template<int _N, typename = std::enable_if_t<(_N > 0)>>
-            inline MaximaArray<_N> maxima() {
+            inline MaximaArray<_N> maxima() const {
                 MaximaArray<_N> _maxima;
                 maxima(_maxima);
                 return _maxima;
             }
 
             template<int _N, typename = std::enable_if_t<(_N > 0)>>
-            inline void maxima(MaximaArray<_N>& _maxima) {
+            inline void maxima(MaximaArray<_N>& _maxima) const {
                 assert((_num_breaks > 0) && "To obtain spline maxima it must be created first with interpolation points.");
 
                 _maxima.setZero();
+                _Maxima(Eigen::Index(0), _num_breaks-1, _maxima);
+                _BoundaryMaxima(_maxima);
+            }
+
+            // k largest maxima, with break point intervals split among "num_threads" threads
+            // (0 - use all hardware threads)
+            inline DynamicMaximaArray maxima(const Eigen::Index k, const unsigned int num_threads = 0) const
+            {
+                DynamicMaximaArray _maxima(k);
+                maxima(_maxima, num_threads);
+                return _maxima;
+            }
+
+            inline void maxima(DynamicMaximaArray& _maxima, unsigned int num_threads = 0) const
+            {
+                assert((_num_breaks > 0) && "To obtain spline maxima it must be created first with interpolation points.");
+
+                // don't spawn threads for less than MinIntervalsPerThread intervals each
+                constexpr Eigen::Index MinIntervalsPerThread = 4096;
+                const Eigen::Index n = _num_breaks - 1;
+                if (num_threads == 0)
+                    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+                num_threads = unsigned(std::clamp(n / MinIntervalsPerThread, Eigen::Index(1), Eigen::Index(num_threads)));
+
+                _maxima.setZero();
+                if (num_threads == 1) {
+                    _Maxima(Eigen::Index(0), n, _maxima);
+                } else {
+                    std::vector<DynamicMaximaArray> partial(num_threads, DynamicMaximaArray(_maxima.capacity()));
+                    std::vector<std::thread> threads;
+                    threads.reserve(num_threads-1);
+                    const Eigen::Index chunk = (n + num_threads - 1) / num_threads;
+                    for (unsigned int t = 1; t < num_threads; ++t)
+                        threads.emplace_back([this, &partial, t, chunk, n]() {
+                                _Maxima(std::min(t*chunk, n), std::min((t+1)*chunk, n), partial[t]);
+                            });
+                    _Maxima(Eigen::Index(0), chunk, partial[0]);
+                    for (std::thread& thread : threads)
+                        thread.join();
+                    for (const DynamicMaximaArray& p : partial)
+                        _maxima.Merge(p);
+                }
+                _BoundaryMaxima(_maxima);
+                _maxima.Sort();
+            }
+
+            // maxima, minima and inflection points in a single pass over all intervals
+            inline CriticalPoints<Scalar> critical_points() const
+            {
+                CriticalPoints<Scalar> points;
+                critical_points(points);
+                return points;
+            }
+
+            inline void critical_points(CriticalPoints<Scalar>& points) const
+            {
+                assert((_num_breaks > 0) && "To obtain spline critical points it must be created first with interpolation points.");
+
+                // Intervals are processed in blocks with vectorized array expressions. Roots of
+                // the derivative 3a*h^2 + 2b*h + c are computed in the cancellation free form
+                // r1 = -t/(3a), r2 = -c/t, with t = b + sign(b)*sqrt(b^2-3ac): r1 is the maximum
+                // for b >= 0, r2 otherwise. For a = 0 (or b = 0) the non existing root becomes
+                // +-inf or NaN and is rejected by the [0,h) range mask, so no branching is needed.
+                constexpr int BlockSize = 256;
+                typedef Eigen::Array<Scalar,Eigen::Dynamic,1,Eigen::ColMajor,BlockSize,1> BlockArray;
+                typedef Eigen::Array<bool,Eigen::Dynamic,1,Eigen::ColMajor,BlockSize,1> BlockMask;
+
+                std::vector<Scalar> max_xy, min_xy, inf_xy;
+                auto push = [](std::vector<Scalar>& xy, const Scalar x, const Scalar y) {
+                    xy.push_back(x);
+                    xy.push_back(y);
+                };
+                auto save = [](std::vector<Scalar>& xy, const BlockArray& x, const BlockArray& y, const BlockMask& mask) {
+                    for (Eigen::Index j = 0; j < mask.size(); ++j)
+                        if (mask(j)) {
+                            xy.push_back(x(j));
+                            xy.push_back(y(j));
+                        }
+                };
+                auto horner = [](const auto& a, const auto& b, const auto& c, const auto& d, const BlockArray& h) -> BlockArray {
+                    return ((a*h+b)*h+c)*h+d;
+                };
+
+                // boundary extrema at first break point
+                const Eigen::Index n = _num_breaks - 1;
+                const Scalar slope0 = derivative(_breaks(0), 1, 0);
+                if (slope0 != Scalar(0.0))
+                    push(slope0 < Scalar(0.0) ? max_xy : min_xy, _breaks(0), (*this)(_breaks(0),0));
+
+                BlockArray len, t, r1, r2, hmax, hmin, hinf;
+                BlockMask extremum, inflection;
+                for (Eigen::Index i0 = 0; i0 < n; i0 += BlockSize) {
+                    const Eigen::Index m = std::min(Eigen::Index(BlockSize), n - i0);
+                    const auto a = _coeffs.col(0).segment(i0,m).template cast<Scalar>();
+                    const auto b = _coeffs.col(1).segment(i0,m).template cast<Scalar>();
+                    const auto c = _coeffs.col(2).segment(i0,m).template cast<Scalar>();
+                    const auto d = _coeffs.col(3).segment(i0,m).template cast<Scalar>();
+                    const auto x0 = _breaks.segment(i0,m);
+                    len = _breaks.segment(i0+1,m) - x0;
+
+                    const BlockArray disc = b*b - Scalar(3.0)*a*c;
+                    extremum = disc > Scalar(0.0);
+                    t  = (b >= Scalar(0.0)).select(b + disc.max(Scalar(0.0)).sqrt(), b - disc.max(Scalar(0.0)).sqrt());
+                    r1 = -t/(Scalar(3.0)*a);
+                    r2 = -c/t;
+                    hmax = (b >= Scalar(0.0)).select(r1, r2);
+                    hmin = (b >= Scalar(0.0)).select(r2, r1);
+                    hinf = -b/(Scalar(3.0)*a);
+
+                    inflection = a != Scalar(0.0) && hinf >= Scalar(0.0) && hinf < len;
+                    // second derivative vanishes at both ends (natural spline): skip first and last intervals
+                    if (i0 == 0)
+                        inflection(0) = false;
+                    if (i0 + m == n)
+                        inflection(m-1) = false;
+
+                    save(max_xy, x0 + hmax, horner(a,b,c,d,hmax), extremum && hmax >= Scalar(0.0) && hmax < len);
+                    save(min_xy, x0 + hmin, horner(a,b,c,d,hmin), extremum && hmin >= Scalar(0.0) && hmin < len);
+                    save(inf_xy, x0 + hinf, horner(a,b,c,d,hinf), inflection);
+                }
+
+                // boundary extrema at last break point
+                const Scalar slope = derivative(_breaks(n), 1, n-1);
+                if (slope != Scalar(0.0))
+                    push(slope > Scalar(0.0) ? max_xy : min_xy, _breaks(n), (*this)(_breaks(n),n-1));
+
+                auto copy = [](typename CriticalPoints<Scalar>::PointList& list, const std::vector<Scalar>& xy) {
+                    list = Eigen::Map<const Eigen::Array<Scalar,Eigen::Dynamic,2,Eigen::RowMajor>>(xy.data(), Eigen::Index(xy.size()/2), 2);
+                };
+                copy(points.maxima, max_xy);
+                copy(points.minima, min_xy);
+                copy(points.inflections, inf_xy);
+            }
+
+        private:
+            // fits arena slots with _Solve
+            template<typename, typename> friend class SplinePool;
+
+            typedef Eigen::Array<Scalar,BreaksSize,1,Eigen::ColMajor> BreaksVector;
+            typedef Eigen::Array<CoeffScalar,CoefsSize,4,Eigen::ColMajor> CoefsVector;
+
+            static constexpr bool Interleaved = std::is_same_v<Layout,InterleavedLayout>;
+
+            Eigen::Index _num_breaks;
+            BreaksVector _breaks;
+            CoefsVector _coeffs;
+            [[no_unique_address]] typename Layout::template Storage<Scalar,CoeffScalar,CoefsSize> _storage;
+
+            // integrals from first break point up to each break point (built on demand)
+            mutable BreaksVector _integrals;
+            mutable std::atomic<bool> _integrals_valid;
+            mutable std::mutex _integrals_mutex;
+
+            // inner break points in Eytzinger order and their interval indexes (dynamic size only)
+            Eigen::Array<Scalar,Eigen::Dynamic,1> _eytzinger;
+            Eigen::Array<Eigen::Index,Eigen::Dynamic,1> _eytzinger_rank;
+
+            // save interior maxima of intervals [i0,i1)
+            template<typename MaximaArrayType>
+            inline void _Maxima(const Eigen::Index i0, const Eigen::Index i1, MaximaArrayType& _maxima) const
+            {
                 Scalar x;
-                for (Eigen::Index i = 0; i < _num_breaks - 1; ++i) {
-                    if (_coeffs(i,0) != Scalar(0.0)) {
-                        x  = _coeffs(i,1)*_coeffs(i,1)-Scalar(3.0)*_coeffs(i,0)*_coeffs(i,2);
+                for (Eigen::Index i = i0; i < i1; ++i) {
+                    const Scalar a = Scalar(_coeffs(i,0));
+                    const Scalar b = Scalar(_coeffs(i,1));
+                    const Scalar c = Scalar(_coeffs(i,2));
+                    if (a != Scalar(0.0)) {
+                        x  = b*b-Scalar(3.0)*a*c;
                         if ( x > Scalar(0.0) ) {
-                            if (_coeffs(i,1) >= Scalar(0.0)) {
-                                if (_coeffs(i,0) < Scalar(0.0)) {
-                                    x = _breaks(i) - (_coeffs(i,1)+std::sqrt(x))/(Scalar(3.0)*_coeffs(i,0));
+                            if (b >= Scalar(0.0)) {
+                                if (a < Scalar(0.0)) {
+                                    x = _breaks(i) - (b+std::sqrt(x))/(Scalar(3.0)*a);
                                     if (x < _breaks(i+1))
                                         // _SaveMaximum(_maxima,x,(*this)(x,i));
                                         _maxima.Save(x,(*this)(x,i));
                                 }
                             } else {
-                                x = _coeffs(i,1) + std::sqrt(x);
-                                if ( (x >= Scalar(0.0) && _coeffs(i,0) < Scalar(0.0))
-                                        || (x <= Scalar(0.0) && _coeffs(i,0) > Scalar(0.0))) {
-                                    x = _breaks(i) - x/(Scalar(3.0)*_coeffs(i,0));
+                                x = b + std::sqrt(x);
+                                if ( (x >= Scalar(0.0) && a < Scalar(0.0))
+                                        || (x <= Scalar(0.0) && a > Scalar(0.0))) {
+                                    x = _breaks(i) - x/(Scalar(3.0)*a);
                                     if (x < _breaks(i+1))
                                         // _SaveMaximum(_maxima,x,(*this)(x,i));
                                         _maxima.Save(x,(*this)(x,i));
                                 }
                             }
                         }
-                    } else if (_coeffs(i,1) < Scalar(0.0) && _coeffs(i,2) >= Scalar(0.0)) {
-                        x = _breaks(i) - Scalar(0.5)*_coeffs(i,2)/_coeffs(i,1);
+                    } else if (b < Scalar(0.0) && c >= Scalar(0.0)) {
+                        x = _breaks(i) - Scalar(0.5)*c/b;
                         if (x < _breaks(i+1))
                             // _SaveMaximum(_maxima,x,(*this)(x,i));
                             _maxima.Save(x,(*this)(x,i));
                     }
                 }
+            }
 
+            // save maxima at first and last break points
+            template<typename MaximaArrayType>
+            inline void _BoundaryMaxima(MaximaArrayType& _maxima) const
+            {
                 // check boundaries
-                if ( _coeffs(0,2) < Scalar(0.0) ) {
-                    _maxima.Save(_breaks(0),_coeffs(0,3));
+                if ( Scalar(_coeffs(0,2)) < Scalar(0.0) ) {
+                    _maxima.Save(_breaks(0),Scalar(_coeffs(0,3)));
                 }
 
-                x = _breaks(_num_breaks-1) - _breaks(_num_breaks-2);
-                if ( (Scalar(3.0)*_coeffs(_num_breaks-2,0)*x
-                        + Scalar(2.0)*_coeffs(_num_breaks-2,1))*x
-                        + _coeffs(_num_breaks-2,2) > Scalar(0.0) ) {
+                if ( derivative(_breaks(_num_breaks-1), 1, _num_breaks-2) > Scalar(0.0) ) {
                     _maxima.Save(_breaks(_num_breaks-1),(*this)(_breaks(_num_breaks-1),_num_breaks-2));
                 }
             }
 
-        private:
-            typedef Eigen::Array<Scalar,BreaksSize,1,Eigen::ColMajor> BreaksVector;
-            typedef Eigen::Array<Scalar,CoefsSize,4,Eigen::ColMajor> CoefsVector;
+            // break point and coefficients of interval "it" for point evaluation
+            inline Scalar _Break(const Eigen::Index& it) const
+            {
+                if constexpr (Interleaved)
+                    return _storage.records[it].x;
+                else
+                    return _breaks(it);
+            }
 
-            Eigen::Index _num_breaks;
-            BreaksVector _breaks;
-            CoefsVector _coeffs;
+            inline Scalar _Coef(const Eigen::Index& it, const int k) const
+            {
+                if constexpr (Interleaved)
+                    return Scalar(_storage.records[it].c[k]);
+                else
+                    return Scalar(_coeffs(it,k));
+            }
+
+            inline void _SetRecords()
+            {
+                if constexpr (Interleaved) {
+                    if constexpr (CoefsSize == Eigen::Dynamic)
+                        _storage.records.resize(_num_breaks-1);
+                    for (Eigen::Index i = 0; i < _num_breaks - 1; ++i) {
+                        _storage.records[i].x = _breaks(i);
+                        for (int k = 0; k < 4; ++k)
+                            _storage.records[i].c[k] = _coeffs(i,k);
+                    }
+                }
+            }
+
+            // index of the interval containing x (clamped to first/last interval)
+            inline Eigen::Index _Interval(const Scalar x) const
+            {
+                if constexpr (BreaksSize == Eigen::Dynamic)
+                    if (_eytzinger.size() > 0)
+                        return _EytzingerInterval(x);
+                const Scalar* pos = std::upper_bound(_breaks.data()+1, _breaks.data()+_num_breaks-1, x);
+                return Eigen::Index(std::distance(_breaks.data(),pos)) - Eigen::Index(1);
+            }
+
+            // Interval search over the inner break points stored in Eytzinger (BFS) order: the
+            // first levels of the implicit tree share cache lines, the descent is branch free and
+            // the grand-grand-children block is prefetched while comparing.
+            inline Eigen::Index _EytzingerInterval(const Scalar x) const
+            {
+                const Eigen::Index m = _eytzinger.size() - 1;
+                const Scalar* e = _eytzinger.data();
+                Eigen::Index k = 1;
+                while (k <= m) {
+#if defined(__GNUC__) || defined(__clang__)
+                    __builtin_prefetch(e + 16*k);
+#endif
+                    k = 2*k + Eigen::Index(e[k] <= x);
+                }
+                // remove the trailing right turns (and the last left one) to get the answer node
+                k >>= std::countr_one(static_cast<std::make_unsigned_t<Eigen::Index>>(k)) + 1;
+                return k == 0 ? _num_breaks - 2 : _eytzinger_rank[k];
+            }
+
+            inline void _SetEytzinger()
+            {
+                if constexpr (BreaksSize == Eigen::Dynamic) {
+                    const Eigen::Index m = _num_breaks - 2;
+                    if (m < SearchIndexMinBreaks) {
+                        _eytzinger.resize(0);
+                        _eytzinger_rank.resize(0);
+                        return;
+                    }
+                    _eytzinger.resize(m+1);
+                    _eytzinger_rank.resize(m+1);
+                    _eytzinger(0) = std::numeric_limits<Scalar>::quiet_NaN();
+                    _eytzinger_rank(0) = 0;
+                    // in-order traversal of the implicit tree visits inner break points in order
+                    Eigen::Index i = 1;
+                    auto fill = [&](auto&& self, Eigen::Index k) -> void {
+                        if (k > m)
+                            return;
+                        self(self, 2*k);
+                        _eytzinger(k) = _breaks(i);
+                        _eytzinger_rank(k) = i - 1;     // interval that ends at break point i
+                        ++i;
+                        self(self, 2*k+1);
+                    };
+                    fill(fill, Eigen::Index(1));
+                }
+            }
+
+            // Interval containing x, searched starting from interval "it": the bracket is grown
+            // exponentially up or down from "it" and then bisected, so the cost is O(log d)
+            // where d is the distance in intervals from "it".
+            inline Eigen::Index _Hunt(const Scalar x, const Eigen::Index it) const
+            {
+                const Eigen::Index last = _num_breaks - 2;
+                Eigen::Index lo, hi, step = 1;
+                if (x >= _breaks(it)) {
+                    if (it == last || x < _breaks(it+1))
+                        return it;
+                    lo = it + 1;
+                    while (lo + step <= last && _breaks(lo+step) <= x) {
+                        lo += step;
+                        step *= 2;
+                    }
+                    hi = std::min(lo + step, last + 1);
+                } else {
+                    if (it == 0)
+                        return it;
+                    hi = it;
+                    while (hi - step >= 1 && _breaks(hi-step) > x) {
+                        hi -= step;
+                        step *= 2;
+                    }
+                    lo = std::max(hi - step, Eigen::Index(0));
+                }
+                const Scalar* pos = std::upper_bound(_breaks.data()+lo+1, _breaks.data()+hi, x);
+                return Eigen::Index(std::distance(_breaks.data(),pos)) - Eigen::Index(1);
+            }
+
+            // integral of interval "it" polynomial over [0,h]
+            inline Scalar _SegmentIntegral(const Eigen::Index& it, const Scalar h) const
+            {
+                return (((Scalar(0.25)*_Coef(it,0)*h+_Coef(it,1)/Scalar(3.0))*h+Scalar(0.5)*_Coef(it,2))*h+_Coef(it,3))*h;
+            }
+
+            inline const BreaksVector& _Integrals() const
+            {
+                assert((_num_breaks > 0) && "To integrate spline it must be created first with interpolation points.");
+                // double-checked: built once under lock, read only afterwards
+                if (!_integrals_valid.load(std::memory_order_acquire)) {
+                    std::lock_guard<std::mutex> lock(_integrals_mutex);
+                    if (!_integrals_valid.load(std::memory_order_relaxed)) {
+                        if constexpr (BreaksSize == Eigen::Dynamic)
+                            if (_integrals.size() < _num_breaks)
+                                _integrals.resize(_num_breaks);
+                        _integrals(0) = Scalar(0.0);
+                        for (Eigen::Index i = 0; i < _num_breaks - 1; ++i)
+                            _integrals(i+1) = _integrals(i) + _SegmentIntegral(i,_breaks(i+1)-_breaks(i));
+                        _integrals_valid.store(true, std::memory_order_release);
+                    }
+                }
+                return _integrals;
+            }
+
+            // evaluate points [i0,i1) of x, block by block
+            template<typename ArrayType>
+            inline void _Evaluate(const Eigen::ArrayBase<ArrayType>& x, Scalar* y, const Eigen::Index i0, const Eigen::Index i1) const
+            {
+                Eigen::Index it = 0;
+                for (Eigen::Index b0 = i0; b0 < i1; b0 += BatchBlockSize) {
+                    const Eigen::Index b1 = std::min(b0 + BatchBlockSize, i1);
+                    bool sorted = true;
+                    for (Eigen::Index i = b0 + 1; i < b1; ++i)
+                        sorted &= !(Scalar(x(i)) < Scalar(x(i-1)));
+                    if (sorted) {
+                        for (Eigen::Index i = b0; i < b1; ++i) {
+                            it = _Hunt(Scalar(x(i)), it);
+                            y[i] = (*this)(Scalar(x(i)), it);
+                        }
+                    } else {
+                        for (Eigen::Index i = b0; i < b1; ++i)
+                            y[i] = (*this)(Scalar(x(i)));
+                    }
+                }
+            }
+
+            // integrals of the source may still be under construction by another thread until published
+            inline void _CopyIntegrals(const Spline& spline)
+            {
+                if (spline._integrals_valid.load(std::memory_order_acquire)) {
+                    _integrals = spline._integrals;
+                    _integrals_valid.store(true, std::memory_order_relaxed);
+                }
+            }
 
             template<typename ArrayTypeX, typename ArrayTypeY>
             inline void _AssertSize(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
@@ -241,6 +944,7 @@ namespace Spline {
             inline void _SetSpline(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
             {
                 _num_breaks = x.size();
+                _integrals_valid.store(false, std::memory_order_relaxed);
                 if constexpr (BreaksSize == Eigen::Dynamic) {
                     if (_breaks.size() < x.size()) {
                         _breaks.resize(_num_breaks);
@@ -248,65 +952,96 @@ namespace Spline {
                     }
                 }
 
-                const Eigen::Index n = _num_breaks;
+                // fit with the precision of the interpolation points if it's higher than the storage one
+                typedef std::common_type_t<Scalar,typename ArrayTypeX::Scalar,typename ArrayTypeY::Scalar> FitScalar;
+                if constexpr (std::is_same_v<FitScalar,Scalar> && std::is_same_v<FitScalar,CoeffScalar>) {
+                    // solve in place: no allocation
+                    _Solve(x.template cast<Scalar>(), y.template cast<Scalar>(), _breaks, _coeffs);
+                } else {
+                    Eigen::Array<FitScalar,BreaksSize,1> breaks;
+                    Eigen::Array<FitScalar,CoefsSize,4> coeffs;
+                    if constexpr (BreaksSize == Eigen::Dynamic) {
+                        breaks.resize(_num_breaks);
+                        coeffs.resize(_num_breaks - 1,4);
+                    }
+                    // break points rounded to Scalar first, so that the polynomials fit the stored breaks
+                    _Solve(x.template cast<Scalar>().template cast<FitScalar>(), y.template cast<FitScalar>(), breaks, coeffs);
+                    _breaks.head(_num_breaks) = breaks.head(_num_breaks).template cast<Scalar>();
+                    _coeffs.topRows(_num_breaks-1) = coeffs.topRows(_num_breaks-1).template cast<CoeffScalar>();
+                }
+                _SetRecords();
+                _SetEytzinger();
+            }
+
+            // natural cubic spline coefficients for interpolation points (x,y); "breaks" and
+            // "coeffs" are also used as workspace and must have at least x.size() rows
+            template<typename ArrayTypeX, typename ArrayTypeY, typename BreaksType, typename CoefsType>
+            static inline void _Solve(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y,
+                    Eigen::ArrayBase<BreaksType>& breaks, Eigen::ArrayBase<CoefsType>& coeffs)
+            {
+                typedef typename BreaksType::Scalar FitScalar;
+                const Eigen::Index n = x.size();
                 assert(((x.segment(1,n-1) > x.segment(0,n-1)).all()) && "Break points must be in assending order." );
 
                 // check if x is sorted
 
                 if ( n == 2) {
-                    _breaks(0) = x(0);
-                    _breaks(1) = x(1);
-                    _coeffs(0,0) = (y(1)-y(0))/(x(1)-x(0));
-                    _coeffs(0,1) = y(0);
+                    breaks(0) = x(0);
+                    breaks(1) = x(1);
+                    coeffs(0,0) = FitScalar(0.0);
+                    coeffs(0,1) = FitScalar(0.0);
+                    coeffs(0,2) = (y(1)-y(0))/(x(1)-x(0));
+                    coeffs(0,3) = y(0);
                     return;
                 }
 
                 // auxiliar
-                _breaks.head(n-1) = x.segment(1,n-1) - x.segment(0,n-1);                                   // Dx
-                _coeffs.col(2).head(n-1)    = (y.segment(1,n-1) - y.segment(0,n-1)) / _breaks.head(n-1);   // Dy/Dx
+                breaks.head(n-1) = x.segment(1,n-1) - x.segment(0,n-1);                                   // Dx
+                coeffs.col(2).head(n-1)    = (y.segment(1,n-1) - y.segment(0,n-1)) / breaks.head(n-1);   // Dy/Dx
 
                 // RHS
-                _coeffs.col(1)(0) = Scalar(0.0);
-                _coeffs.col(1).segment(1,n-2) = Scalar(3.0) * (_coeffs.col(2).segment(1,n-2) - _coeffs.col(2).segment(0,n-2));
+                coeffs.col(1)(0) = FitScalar(0.0);
+                coeffs.col(1).segment(1,n-2) = FitScalar(3.0) * (coeffs.col(2).segment(1,n-2) - coeffs.col(2).segment(0,n-2));
 
                 // main diagonal (with boundary conditions)
-                _coeffs.col(3).segment(1,n-4) = 2.0 * (x.segment(3,n-4) - x.segment(1,n-4));
-                _coeffs.col(3)(0) = 2.0 * (x(2) - x(0));
-                _coeffs.col(3)(n-3) = 2.0 * (x(n-1) - x(n-3));
+                if (n > 3)
+                    coeffs.col(3).segment(1,n-4) = 2.0 * (x.segment(3,n-4) - x.segment(1,n-4));
+                coeffs.col(3)(0) = 2.0 * (x(2) - x(0));
+                coeffs.col(3)(n-3) = 2.0 * (x(n-1) - x(n-3));
 
                 // sub-diagonal
-                _coeffs.col(0).head(n-3) = _breaks.segment(1,n-3);
+                coeffs.col(0).head(n-3) = breaks.segment(1,n-3);
 
                 // solve symmetric positive defined tridiagonal system
-                Scalar d, l;
-                l = _coeffs.col(0)(0);
-                _coeffs.col(0)(0) /=  _coeffs.col(3)(0);
-                _coeffs.col(1)(1) /=  _coeffs.col(3)(0);
+                FitScalar d, l;
+                l = coeffs.col(0)(0);
+                coeffs.col(0)(0) /=  coeffs.col(3)(0);
+                coeffs.col(1)(1) /=  coeffs.col(3)(0);
                 for (Eigen::Index i = 1; i < n-2; ++i ) {
-                    d = Scalar(1.0) / (_coeffs.col(3)(i) - _coeffs.col(0)(i-1)*l);
-                    _coeffs.col(1)(i+1) = (_coeffs.col(1)(i+1) - _coeffs.col(1)(i)*l)*d;
-                    l = _coeffs.col(0)(i);
-                    _coeffs.col(0)(i) = _coeffs.col(0)(i)*d;
+                    d = FitScalar(1.0) / (coeffs.col(3)(i) - coeffs.col(0)(i-1)*l);
+                    coeffs.col(1)(i+1) = (coeffs.col(1)(i+1) - coeffs.col(1)(i)*l)*d;
+                    l = coeffs.col(0)(i);
+                    coeffs.col(0)(i) = coeffs.col(0)(i)*d;
                 }
                 for (Eigen::Index i = n-4; i >= 0; i-- ) {
-                    _coeffs.col(1)(i+1) = _coeffs.col(1)(i+1) - _coeffs.col(0)(i)*_coeffs.col(1)(i+2);
+                    coeffs.col(1)(i+1) = coeffs.col(1)(i+1) - coeffs.col(0)(i)*coeffs.col(1)(i+2);
                 }
 
                 // coefficients
-                _coeffs.col(0).head(n-2) = (_coeffs.col(1).segment(1,n-2) - _coeffs.col(1).segment(0,n-2)) /
-                                          (Scalar(3.0) * _breaks.head(n-2));
-                _coeffs.col(0)(n-2) = - _coeffs.col(1)(n-2) /
-                                        (Scalar(3.0) * _breaks(n-2));
+                coeffs.col(0).head(n-2) = (coeffs.col(1).segment(1,n-2) - coeffs.col(1).segment(0,n-2)) /
+                                          (FitScalar(3.0) * breaks.head(n-2));
+                coeffs.col(0)(n-2) = - coeffs.col(1)(n-2) /
+                                        (FitScalar(3.0) * breaks(n-2));
 
-                _coeffs.col(2).head(n-2) = _coeffs.col(2).head(n-2) -
-                                        (Scalar(2.0)*_coeffs.col(1).segment(0,n-2) + _coeffs.col(1).segment(1,n-2)) *
-                                        _breaks.head(n-2) / Scalar(3.0);
-                _coeffs.col(2)(n-2) = _coeffs.col(2)(n-2) -
-                                     Scalar(2.0)*_coeffs.col(1)(n-2) *
-                                     _breaks(n-2) / Scalar(3.0);
+                coeffs.col(2).head(n-2) = coeffs.col(2).head(n-2) -
+                                        (FitScalar(2.0)*coeffs.col(1).segment(0,n-2) + coeffs.col(1).segment(1,n-2)) *
+                                        breaks.head(n-2) / FitScalar(3.0);
+                coeffs.col(2)(n-2) = coeffs.col(2)(n-2) -
+                                     FitScalar(2.0)*coeffs.col(1)(n-2) *
+                                     breaks(n-2) / FitScalar(3.0);
 
-                _coeffs.col(3).head(n-1) = y.head(n-1);
-                _breaks.head(n) = x;
+                coeffs.col(3).head(n-1) = y.head(n-1);
+                breaks.head(n) = x;
             }
 
     };
@@ -320,8 +1055,122 @@ namespace Spline {
         Spline(const Eigen::ArrayBase<ArrayTypeX>&, const Eigen::ArrayBase<ArrayTypeY>&) ->
             Spline<std::common_type_t<typename ArrayTypeX::Scalar,typename ArrayTypeY::Scalar>, (ArrayTypeX::SizeAtCompileTime == ArrayTypeY::SizeAtCompileTime ? ArrayTypeX::SizeAtCompileTime : Eigen::Dynamic)>;
 
-    template<typename Scalar, int Size>
-        Spline(const Spline<Scalar,Size>&) -> Spline<Scalar,Size>;
+    template<typename Scalar, int Size, typename Layout, typename Coeff>
+        Spline(const Spline<Scalar,Size,Layout,Coeff>&) -> Spline<Scalar,Size,Layout,Coeff>;
+
+    // Natural cubic spline with small compile-time number of break points (ex.: 4 to 32). Storage
+    // is std::array, all loops are unrolled at compile time (fold expressions over index sequences),
+    // interval search is a branch free comparison count, and everything is constexpr, so splines
+    // fitted from constant tables can be evaluated at compile time:
+    //
+    //   constexpr Spline::SmallSpline<double,4> S(std::array{0.0,1.0,2.0,3.0}, std::array{0.0,1.0,0.0,1.0});
+    //   static_assert(S(1.0) == 1.0);
+    template<typename _Scalar, int _Size>
+    class SmallSpline
+    {
+        static_assert(_Size > 1, " Number of interpolation points is less then 2.");
+
+        public:
+            enum { Size = _Size };
+            typedef _Scalar Scalar;
+            typedef std::array<Scalar,Size> Points;
+            typedef std::array<std::array<Scalar,4>,Size-1> Coefs;
+
+            constexpr SmallSpline() : _breaks{}, _coeffs{} {}
+            constexpr SmallSpline(const Points& x, const Points& y) : _breaks{}, _coeffs{} { set(x,y); }
+
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            SmallSpline(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y) : _breaks{}, _coeffs{}
+            {
+                assert((x.size() == Size && y.size() == Size) && "x and y-coordenates vectors of interpolation points must have SmallSpline size.");
+                Points px{}, py{};
+                _Unroll<Size>([&](auto i) {
+                        px[i] = Scalar(x(Eigen::Index(i)));
+                        py[i] = Scalar(y(Eigen::Index(i)));
+                    });
+                set(px,py);
+            }
+
+            constexpr void set(const Points& x, const Points& y)
+            {
+                // interval lengths and divided differences
+                std::array<Scalar,Size-1> h{}, delta{};
+                _Unroll<Size-1>([&](auto i) {
+                        h[i] = x[i+1] - x[i];
+                        delta[i] = (y[i+1] - y[i]) / h[i];
+                    });
+
+                // Thomas algorithm for the quadratic coefficients b[1..Size-2], b[0] = b[Size-1] = 0
+                std::array<Scalar,Size> b{}, c{};
+                _Unroll<Size-2>([&](auto k) {
+                        constexpr int i = k + 1;
+                        const Scalar m = Scalar(2.0)*(h[i-1] + h[i]) - (i > 1 ? h[i-1]*c[i-1] : Scalar(0.0));
+                        c[i] = h[i] / m;
+                        b[i] = (Scalar(3.0)*(delta[i] - delta[i-1]) - (i > 1 ? h[i-1]*b[i-1] : Scalar(0.0))) / m;
+                    });
+                _Unroll<Size-2>([&](auto k) {
+                        constexpr int i = Size - 2 - k;
+                        if constexpr (i < Size - 2)
+                            b[i] -= c[i]*b[i+1];
+                    });
+
+                _Unroll<Size-1>([&](auto i) {
+                        _coeffs[i][0] = (b[i+1] - b[i]) / (Scalar(3.0)*h[i]);
+                        _coeffs[i][1] = b[i];
+                        _coeffs[i][2] = delta[i] - h[i]*(Scalar(2.0)*b[i] + b[i+1]) / Scalar(3.0);
+                        _coeffs[i][3] = y[i];
+                    });
+                _breaks = x;
+            }
+
+            static constexpr int num_breaks() { return Size; }
+            constexpr const Points& breaks() const { return _breaks; }
+            constexpr const Coefs& coefs() const { return _coeffs; }
+
+            // index of the interval containing x (clamped to first/last interval)
+            constexpr int interval(const Scalar x) const
+            {
+                return [&]<std::size_t... I>(std::index_sequence<I...>) {
+                    return (0 + ... + int(_breaks[I+1] <= x));
+                }(std::make_index_sequence<Size-2>{});
+            }
+
+            constexpr Scalar operator()(const Scalar x) const { return (*this)(x,interval(x)); }
+            constexpr Scalar operator()(const Scalar x, const int it) const
+            {
+                const Scalar h = x - _breaks[it];
+                return ((_coeffs[it][0]*h+_coeffs[it][1])*h+_coeffs[it][2])*h+_coeffs[it][3];
+            }
+
+            // derivative of given order (order 0 is the spline value, orders above 3 are zero)
+            constexpr Scalar derivative(const Scalar x, const int order = 1) const
+            {
+                const int it = interval(x);
+                const Scalar h = x - _breaks[it];
+                const std::array<Scalar,4>& c = _coeffs[it];
+                switch (order) {
+                    case 0:  return ((c[0]*h+c[1])*h+c[2])*h+c[3];
+                    case 1:  return (Scalar(3.0)*c[0]*h+Scalar(2.0)*c[1])*h+c[2];
+                    case 2:  return Scalar(6.0)*c[0]*h+Scalar(2.0)*c[1];
+                    case 3:  return Scalar(6.0)*c[0];
+                    default: return Scalar(0.0);
+                }
+            }
+
+        private:
+            Points _breaks;
+            Coefs _coeffs;
+
+            // call f(std::integral_constant<int,I>) for I = 0..N-1
+            template<int N, typename Function>
+            static constexpr void _Unroll(Function&& f)
+            {
+                if constexpr (N > 0)
+                    [&]<int... I>(std::integer_sequence<int,I...>) {
+                        (f(std::integral_constant<int,I>{}), ...);
+                    }(std::make_integer_sequence<int,N>{});
+            }
+    };
 
     template<typename _T, int _Size>
     std::ostream& operator<<(std::ostream& out, const CriticalPointArray<_T,_Size>& _array)
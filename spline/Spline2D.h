@@ -0,0 +1,247 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _Spline2D_h
+#define _Spline2D_h
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "Spline1D.h"
+
+namespace Spline {
+
+    // Bicubic tensor-product natural spline interpolating gridded values z(i,j) = f(x(i),y(j)).
+    //
+    // Fitting is two batched passes of the natural cubic spline solve of Spline: one along x for all
+    // grid rows at once, then one along y for the 4 x-coefficients of all x intervals at once. The
+    // tridiagonal system of an axis is the same for every right hand side, so each elimination step
+    // updates one contiguous row of all right hand sides (vectorized by Eigen).
+    //
+    // Cell (i,j) = [x(i),x(i+1)]x[y(j),y(j+1)] stores 16 coefficients c[p][q] of hx^(3-p)*hy^(3-q),
+    // with hx = x - x(i), hy = y - y(j). Cells are stored in tiles of TileSize x TileSize cells, so
+    // nearby queries touch nearby memory. Cell lookup is O(1) on uniform axes (detected at fit time)
+    // and a binary search otherwise.
+    template<typename _Scalar>
+    class Spline2D
+    {
+        public:
+            typedef _Scalar Scalar;
+            typedef Eigen::Array<Scalar,Eigen::Dynamic,1> Vector;
+            typedef Eigen::Array<Scalar,4,4,Eigen::RowMajor> CellCoefs;
+
+            static constexpr Eigen::Index TileSize = 4;
+
+            Spline2D() : _x(), _y(), _tiles_y(0), _coeffs() {}
+
+            template<typename ArrayTypeX, typename ArrayTypeY, typename ArrayTypeZ>
+            Spline2D(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y, const Eigen::ArrayBase<ArrayTypeZ>& z)
+            : _x(), _y(), _tiles_y(0), _coeffs()
+            {
+                set(x,y,z);
+            }
+
+            template<typename ArrayTypeX, typename ArrayTypeY, typename ArrayTypeZ>
+            inline void set(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y, const Eigen::ArrayBase<ArrayTypeZ>& z)
+            {
+                assert((x.size() > 1 && y.size() > 1) && " Number of interpolation points is less then 2.");
+                assert((z.rows() == x.size() && z.cols() == y.size()) && "z must have x.size() rows and y.size() columns.");
+                const Eigen::Index nx = x.size(), ny = y.size();
+                _x.set(x.template cast<Scalar>());
+                _y.set(y.template cast<Scalar>());
+
+                // pass along x: row i of values holds z at x(i) for all y
+                RowMajorArray values = z.template cast<Scalar>();
+                std::array<RowMajorArray,4> a;
+                _FitBatch(_x.breaks, values, a);
+
+                // pass along y: column p*(nx-1)+i holds x-coefficient p of interval i for all y
+                values.resize(ny, 4*(nx-1));
+                for (int p = 0; p < 4; ++p)
+                    values.middleCols(p*(nx-1),nx-1) = a[p].transpose();
+                std::array<RowMajorArray,4> c;
+                _FitBatch(_y.breaks, values, c);
+
+                // scatter to tiled cells
+                _tiles_y = (ny - 1 + TileSize - 1) / TileSize;
+                const Eigen::Index tiles_x = (nx - 1 + TileSize - 1) / TileSize;
+                _coeffs.setZero(16*TileSize*TileSize*tiles_x*_tiles_y);
+                for (Eigen::Index j = 0; j < ny - 1; ++j)
+                    for (Eigen::Index i = 0; i < nx - 1; ++i) {
+                        Scalar* cell = _coeffs.data() + 16*_Cell(i,j);
+                        for (int p = 0; p < 4; ++p)
+                            for (int q = 0; q < 4; ++q)
+                                cell[4*p+q] = c[q](j,p*(nx-1)+i);
+                    }
+            }
+
+            inline Eigen::Index num_breaks_x() const { return _x.breaks.size(); }
+            inline Eigen::Index num_breaks_y() const { return _y.breaks.size(); }
+            inline const Vector& breaks_x() const { return _x.breaks; }
+            inline const Vector& breaks_y() const { return _y.breaks; }
+            inline bool uniform_x() const { return _x.uniform; }
+            inline bool uniform_y() const { return _y.uniform; }
+
+            // coefficients of cell (i,j)
+            inline Eigen::Map<const CellCoefs> coefs(const Eigen::Index i, const Eigen::Index j) const
+            {
+                return Eigen::Map<const CellCoefs>(_coeffs.data() + 16*_Cell(i,j));
+            }
+
+            inline Scalar operator()(const Scalar x, const Scalar y) const
+            {
+                const Eigen::Index i = _x.interval(x), j = _y.interval(y);
+                return _Evaluate(_coeffs.data() + 16*_Cell(i,j), x - _x.breaks(i), y - _y.breaks(j));
+            }
+
+            // evaluation at points (x(k),y(k))
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline Eigen::Array<Scalar,ArrayTypeX::RowsAtCompileTime,ArrayTypeX::ColsAtCompileTime>
+            operator()(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y) const
+            {
+                assert((x.size() == y.size()) && "x and y-coordenates of query points must have same size.");
+                Eigen::Array<Scalar,ArrayTypeX::RowsAtCompileTime,ArrayTypeX::ColsAtCompileTime> z(x.rows(),x.cols());
+                for (Eigen::Index k = 0; k < x.size(); ++k)
+                    z(k) = (*this)(Scalar(x(k)), Scalar(y(k)));
+                return z;
+            }
+
+            // evaluation on the grid x by y: z(k,l) at (x(k),y(l)), cells of each axis looked up once
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline Eigen::Array<Scalar,Eigen::Dynamic,Eigen::Dynamic>
+            grid(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y) const
+            {
+                Eigen::Array<Eigen::Index,Eigen::Dynamic,1> ix(x.size());
+                Vector hx(x.size());
+                for (Eigen::Index k = 0; k < x.size(); ++k) {
+                    ix(k) = _x.interval(Scalar(x(k)));
+                    hx(k) = Scalar(x(k)) - _x.breaks(ix(k));
+                }
+                Eigen::Array<Scalar,Eigen::Dynamic,Eigen::Dynamic> z(x.size(),y.size());
+                for (Eigen::Index l = 0; l < y.size(); ++l) {
+                    const Eigen::Index j = _y.interval(Scalar(y(l)));
+                    const Scalar hy = Scalar(y(l)) - _y.breaks(j);
+                    for (Eigen::Index k = 0; k < x.size(); ++k)
+                        z(k,l) = _Evaluate(_coeffs.data() + 16*_Cell(ix(k),j), hx(k), hy);
+                }
+                return z;
+            }
+
+        private:
+            typedef Eigen::Array<Scalar,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> RowMajorArray;
+
+            // break points of an axis with O(1) interval lookup when uniformly spaced
+            struct Axis
+            {
+                Vector breaks;
+                Scalar origin = Scalar(0.0), inv_step = Scalar(0.0);
+                bool uniform = false;
+
+                template<typename ArrayType>
+                inline void set(const Eigen::ArrayBase<ArrayType>& b)
+                {
+                    const Eigen::Index n = b.size();
+                    assert(((b.segment(1,n-1) > b.segment(0,n-1)).all()) && "Break points must be in assending order." );
+                    breaks = b;
+                    origin = breaks(0);
+                    const Scalar step = (breaks(n-1) - breaks(0)) / Scalar(n-1);
+                    inv_step = Scalar(1.0) / step;
+                    // uniform if every break point is within a few roundoffs of origin + i*step
+                    const Scalar tol = Scalar(8.0) * std::numeric_limits<Scalar>::epsilon() *
+                                       (std::max(std::abs(breaks(0)), std::abs(breaks(n-1))) + step);
+                    uniform = true;
+                    for (Eigen::Index i = 1; i < n - 1 && uniform; ++i)
+                        uniform = std::abs(breaks(i) - (origin + Scalar(i)*step)) <= tol;
+                }
+
+                // interval of x (first or last one outside the break points range)
+                inline Eigen::Index interval(const Scalar x) const
+                {
+                    const Eigen::Index last = breaks.size() - 2;
+                    if (uniform) {
+                        const Scalar t = (x - origin) * inv_step;
+                        // comparisons also catch NaN and values beyond the Index range
+                        return t >= Scalar(last) ? last : (t > Scalar(0.0) ? Eigen::Index(t) : Eigen::Index(0));
+                    }
+                    const Scalar* pos = std::upper_bound(breaks.data()+1, breaks.data()+last+1, x);
+                    return Eigen::Index(std::distance(breaks.data(),pos)) - Eigen::Index(1);
+                }
+            };
+
+            Axis _x, _y;
+            Eigen::Index _tiles_y;
+            Vector _coeffs;
+
+            // position of cell (i,j) in tiled order
+            inline Eigen::Index _Cell(const Eigen::Index i, const Eigen::Index j) const
+            {
+                return ((i/TileSize)*_tiles_y + j/TileSize)*TileSize*TileSize + (i%TileSize)*TileSize + j%TileSize;
+            }
+
+            static inline Scalar _Evaluate(const Scalar* c, const Scalar hx, const Scalar hy)
+            {
+                Scalar r[4];
+                for (int p = 0; p < 4; ++p)
+                    r[p] = ((c[4*p]*hy+c[4*p+1])*hy+c[4*p+2])*hy+c[4*p+3];
+                return ((r[0]*hx+r[1])*hx+r[2])*hx+r[3];
+            }
+
+            // natural cubic spline coefficients of m functions at once: values(i,k) is function k at
+            // x(i). Same system as Spline::_Solve, with b = S''/2 at break points:
+            //   h(i-1)*b(i-1) + 2*(h(i-1)+h(i))*b(i) + h(i)*b(i+1) = 3*(dy(i)/h(i) - dy(i-1)/h(i-1))
+            // coeffs[p] (n-1 x m) gets the coefficient of h^(3-p) of each interval and function.
+            static inline void _FitBatch(const Vector& x, const RowMajorArray& values, std::array<RowMajorArray,4>& coeffs)
+            {
+                const Eigen::Index n = x.size(), m = values.cols();
+                const Vector h = x.segment(1,n-1) - x.segment(0,n-1);
+                RowMajorArray& b = coeffs[1];
+                b.setZero(n,m);
+
+                if (n > 2) {
+                    // right hand sides
+                    for (Eigen::Index i = 1; i < n - 1; ++i)
+                        b.row(i) = Scalar(3.0) * ((values.row(i+1) - values.row(i)) / h(i) - (values.row(i) - values.row(i-1)) / h(i-1));
+
+                    // forward elimination, pivots depend only on x
+                    Vector pivot(n);
+                    pivot(1) = Scalar(2.0) * (h(0) + h(1));
+                    for (Eigen::Index i = 2; i < n - 1; ++i) {
+                        const Scalar w = h(i-1) / pivot(i-1);
+                        pivot(i) = Scalar(2.0) * (h(i-1) + h(i)) - w * h(i-1);
+                        b.row(i) -= w * b.row(i-1);
+                    }
+                    // back substitution
+                    b.row(n-2) /= pivot(n-2);
+                    for (Eigen::Index i = n - 3; i >= 1; --i)
+                        b.row(i) = (b.row(i) - h(i) * b.row(i+1)) / pivot(i);
+                }
+
+                coeffs[0].resize(n-1,m);
+                coeffs[2].resize(n-1,m);
+                for (Eigen::Index i = 0; i < n - 1; ++i) {
+                    coeffs[0].row(i) = (b.row(i+1) - b.row(i)) / (Scalar(3.0) * h(i));
+                    coeffs[2].row(i) = (values.row(i+1) - values.row(i)) / h(i) - h(i) * (Scalar(2.0) * b.row(i) + b.row(i+1)) / Scalar(3.0);
+                }
+                b.conservativeResize(n-1,m);
+                coeffs[3] = values.topRows(n-1);
+            }
+    };
+
+}
+
+#endif
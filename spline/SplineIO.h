@@ -0,0 +1,386 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SplineIO_h
+#define _SplineIO_h
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Spline1D.h"
+#include "../binaryIO/binaryIO.h"
+
+namespace Spline {
+
+     /** Binary layout of fitted splines.
+       *
+       *  All fields are written in the native endianness of the writer, which is recorded by
+       *  the endian tag (0x0102), so any reader can detect and swap it.
+       *
+       *  Spline record (offsets in bytes from record start):
+       *  +--------------------------------------------------------------------------+
+       *  |  0 | char[4]  | "SPLN"                                                   |
+       *  |  4 | uint16   | version                                                  |
+       *  |  6 | uint16   | endian tag                                               |
+       *  |  8 | uint8    | break points type code                                   |
+       *  |  9 | uint8    | coefficients type code                                   |
+       *  | 10 | uint8[6] | reserved (zero)                                          |
+       *  | 16 | uint64   | n, number of break points                                |
+       *  | 24 | Scalar   | n break points, zero padded to a multiple of 8 bytes     |
+       *  |    | Coeff    | (n-1)x4 coefficients, column-major                       |
+       *  +--------------------------------------------------------------------------+
+       *
+       *  Spline file (many records, all of the same types):
+       *  +--------------------------------------------------------------------------+
+       *  |  0 | char[4]  | "SPLF"                                                   |
+       *  |  4 | uint16   | version                                                  |
+       *  |  6 | uint16   | endian tag                                               |
+       *  |  8 | uint8    | break points type code                                   |
+       *  |  9 | uint8    | coefficients type code                                   |
+       *  | 10 | uint8[6] | reserved (zero)                                          |
+       *  | 16 | uint64   | m, number of splines                                     |
+       *  | 24 | uint64   | m offsets of spline records from the file start          |
+       *  |    |          | records, each starting at a multiple of 64 bytes         |
+       *  +--------------------------------------------------------------------------+
+       *
+       *  With native endianness and types, records are aligned for direct evaluation from a
+       *  memory mapped file (see MappedSplineFile).
+       */
+
+    constexpr std::uint16_t SplineFileVersion = 1;
+    constexpr std::uint16_t SplineEndianTag = 0x0102;
+    constexpr std::size_t SplineHeaderSize = 24;
+    constexpr std::size_t SplineRecordAlignment = 64;
+
+    // type codes of break points and coefficients
+    template<typename T> constexpr std::uint8_t SplineTypeCode = 0;
+    template<> constexpr std::uint8_t SplineTypeCode<double> = 'd';
+    template<> constexpr std::uint8_t SplineTypeCode<float> = 'f';
+    template<> constexpr std::uint8_t SplineTypeCode<Eigen::half> = 'h';
+    template<> constexpr std::uint8_t SplineTypeCode<Eigen::bfloat16> = 'b';
+
+    namespace internal {
+
+        struct SplineHeader
+        {
+            char magic[4];
+            std::uint16_t version;
+            std::uint16_t endian;
+            std::uint8_t scalar;
+            std::uint8_t coeff;
+            std::uint8_t reserved[6];
+            std::uint64_t size;
+        };
+        static_assert(sizeof(SplineHeader) == SplineHeaderSize);
+
+        inline constexpr std::size_t PaddedSize(const std::size_t size, const std::size_t alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        inline std::size_t TypeSize(const std::uint8_t code)
+        {
+            switch (code) {
+                case 'd': return sizeof(double);
+                case 'f': return sizeof(float);
+                case 'h': return sizeof(Eigen::half);
+                case 'b': return sizeof(Eigen::bfloat16);
+                default: throw std::runtime_error("Unknown spline scalar type code: " + std::to_string(int(code)));
+            }
+        }
+
+        template<typename _Scalar, typename _Coeff>
+        inline std::size_t RecordSize(const std::size_t num_breaks)
+        {
+            return SplineHeaderSize + PaddedSize(num_breaks*sizeof(_Scalar),8) + 4*(num_breaks-1)*sizeof(_Coeff);
+        }
+
+        template<char... _Magic>
+        inline SplineHeader MakeHeader(const std::uint8_t scalar, const std::uint8_t coeff, const std::uint64_t size)
+        {
+            SplineHeader header{{_Magic...}, SplineFileVersion, SplineEndianTag, scalar, coeff, {}, size};
+            return header;
+        }
+
+        // read and validate header, return true if data must be byte swapped
+        inline bool CheckHeader(SplineHeader& header, const char* magic)
+        {
+            if (std::memcmp(header.magic, magic, 4) != 0)
+                throw std::runtime_error(std::string("Invalid spline data, expected magic ") + std::string(magic,4));
+            const bool swap = header.endian != SplineEndianTag;
+            if (swap) {
+                if (reverseBytes(header.endian) != SplineEndianTag)
+                    throw std::runtime_error("Invalid spline data endian tag");
+                header.version = reverseBytes(header.version);
+                header.size = reverseBytes(header.size);
+            }
+            if (header.version != SplineFileVersion)
+                throw std::runtime_error("Unsupported spline data version: " + std::to_string(header.version));
+            return swap;
+        }
+
+        template<typename _Target, typename _Source>
+        inline void ReadArray(binIO::BinaryFile<binIO::Read>& file, _Target* out, const std::size_t n, const bool swap)
+        {
+            std::vector<_Source> buffer(n);
+            file.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(n*sizeof(_Source)));
+            if (swap) {
+                typedef std::conditional_t<sizeof(_Source) == 2, std::uint16_t,
+                        std::conditional_t<sizeof(_Source) == 4, std::uint32_t, std::uint64_t>> Bits;
+                for (_Source& v : buffer)
+                    v = std::bit_cast<_Source>(reverseBytes(std::bit_cast<Bits>(v)));
+            }
+            for (std::size_t i = 0; i < n; ++i)
+                out[i] = _Target(buffer[i]);
+        }
+
+        // read "n" values of type "code" from file, converting them to _Target
+        template<typename _Target>
+        inline void ReadArray(binIO::BinaryFile<binIO::Read>& file, const std::uint8_t code, _Target* out, const std::size_t n, const bool swap)
+        {
+            switch (code) {
+                case 'd': ReadArray<_Target,double>(file, out, n, swap); break;
+                case 'f': ReadArray<_Target,float>(file, out, n, swap); break;
+                case 'h': ReadArray<_Target,Eigen::half>(file, out, n, swap); break;
+                case 'b': ReadArray<_Target,Eigen::bfloat16>(file, out, n, swap); break;
+                default: throw std::runtime_error("Unknown spline scalar type code: " + std::to_string(int(code)));
+            }
+        }
+
+        // bytes from the current position to the end of file
+        inline std::uint64_t RemainingBytes(binIO::BinaryFile<binIO::Read>& file)
+        {
+            const std::streampos position = file.tell();
+            const std::streampos end = file.seek(0, std::ios::end);
+            file.seek(position);
+            return end > position ? std::uint64_t(end - position) : 0;
+        }
+
+        template<binIO::FileMode _Mode>
+        inline void WritePadding(binIO::BinaryFile<_Mode>& file, const std::size_t size)
+        {
+            static constexpr char zeros[SplineRecordAlignment] = {};
+            file.write(zeros, std::streamsize(size));
+        }
+    }
+
+    // Write spline record at current file position
+    template<binIO::FileMode _Mode, typename _Scalar, int _Size, typename _Layout, typename _Coeff>
+    inline void write(binIO::BinaryFile<_Mode>& file, const Spline<_Scalar,_Size,_Layout,_Coeff>& spline)
+    {
+        static_assert(SplineTypeCode<_Scalar> != 0 && SplineTypeCode<_Coeff> != 0,
+                "Only double, float, Eigen::half and Eigen::bfloat16 splines can be written.");
+        assert((spline.num_breaks() > 1) && "Spline must be created before writing.");
+
+        const std::size_t n = std::size_t(spline.num_breaks());
+        file.write(internal::MakeHeader<'S','P','L','N'>(SplineTypeCode<_Scalar>, SplineTypeCode<_Coeff>, n));
+        file.write(reinterpret_cast<const char*>(spline.breaks().data()), std::streamsize(n*sizeof(_Scalar)));
+        internal::WritePadding(file, internal::PaddedSize(n*sizeof(_Scalar),8) - n*sizeof(_Scalar));
+        file.write(reinterpret_cast<const char*>(spline.coefs().eval().data()), std::streamsize(4*(n-1)*sizeof(_Coeff)));
+    }
+
+    // Read spline record at current file position (data is converted to spline types if needed)
+    template<typename _Scalar, int _Size, typename _Layout, typename _Coeff>
+    inline void read(binIO::BinaryFile<binIO::Read>& file, Spline<_Scalar,_Size,_Layout,_Coeff>& spline)
+    {
+        internal::SplineHeader header = file.read<internal::SplineHeader>();
+        const bool swap = internal::CheckHeader(header, "SPLN");
+        const std::size_t n = header.size;
+        if (n < 2)
+            throw std::runtime_error("Invalid spline data: less than 2 break points");
+        // sizes checked against the file before allocating (n bounded first, so they can't overflow)
+        const std::uint64_t remaining = internal::RemainingBytes(file);
+        const std::size_t scalar_size = internal::TypeSize(header.scalar), coeff_size = internal::TypeSize(header.coeff);
+        if (n > remaining/scalar_size ||
+                internal::PaddedSize(n*scalar_size,8) + 4*(n-1)*coeff_size > remaining)
+            throw std::runtime_error("Truncated spline data: " + std::to_string(n) + " break points");
+
+        Eigen::Array<_Scalar,Eigen::Dynamic,1> breaks(n);
+        Eigen::Array<_Coeff,Eigen::Dynamic,4> coefs(n-1,4);
+        internal::ReadArray(file, header.scalar, breaks.data(), n, swap);
+        const std::size_t breaks_size = n*scalar_size;
+        file.seek(std::streamoff(internal::PaddedSize(breaks_size,8) - breaks_size), std::ios::cur);
+        internal::ReadArray(file, header.coeff, coefs.data(), 4*(n-1), swap);
+        spline.set_coefs(breaks, coefs);
+    }
+
+    // Save splines to a spline file
+    template<typename _Container>
+    inline void save(const std::filesystem::path& path, const _Container& splines)
+    {
+        typedef typename _Container::value_type SplineType;
+        typedef typename SplineType::Scalar Scalar;
+        typedef typename SplineType::CoeffScalar Coeff;
+
+        const std::size_t m = std::size(splines);
+        std::vector<std::uint64_t> offsets;
+        offsets.reserve(m);
+        std::size_t offset = internal::PaddedSize(SplineHeaderSize + m*sizeof(std::uint64_t), SplineRecordAlignment);
+        for (const SplineType& spline : splines) {
+            offsets.push_back(offset);
+            offset += internal::PaddedSize(internal::RecordSize<Scalar,Coeff>(spline.num_breaks()), SplineRecordAlignment);
+        }
+
+        binIO::BinaryFile<binIO::Write|binIO::Truncate> file(path);
+        file.write(internal::MakeHeader<'S','P','L','F'>(SplineTypeCode<Scalar>, SplineTypeCode<Coeff>, m));
+        file.write(offsets.data(), m);
+        std::size_t position = SplineHeaderSize + m*sizeof(std::uint64_t);
+        std::size_t i = 0;
+        for (const SplineType& spline : splines) {
+            internal::WritePadding(file, offsets[i] - position);
+            write(file, spline);
+            position = offsets[i] + internal::RecordSize<Scalar,Coeff>(spline.num_breaks());
+            ++i;
+        }
+    }
+
+    // Load all splines of a spline file
+    template<typename _SplineType>
+    inline void load(const std::filesystem::path& path, std::vector<_SplineType>& splines)
+    {
+        binIO::BinaryFile<binIO::Read> file(path);
+        internal::SplineHeader header = file.read<internal::SplineHeader>();
+        const bool swap = internal::CheckHeader(header, "SPLF");
+        const std::uintmax_t file_size = std::filesystem::file_size(path);
+        if (header.size > (file_size - SplineHeaderSize)/sizeof(std::uint64_t))
+            throw std::runtime_error("Truncated spline file: " + path.generic_string());
+        std::vector<std::uint64_t> offsets(header.size);
+        file.read(offsets.data(), offsets.size());
+        if (swap)
+            for (std::uint64_t& offset : offsets)
+                offset = reverseBytes(offset);
+
+        splines.resize(offsets.size());
+        for (std::size_t i = 0; i < offsets.size(); ++i) {
+            if (offsets[i] > file_size - SplineHeaderSize)
+                throw std::runtime_error("Invalid spline record offset " + std::to_string(i) + ": " + path.generic_string());
+            file.seek(std::streampos(offsets[i]));
+            read(file, splines[i]);
+        }
+    }
+
+    // Read-only memory mapped spline file: splines are evaluated directly from the mapped
+    // memory without copying. File must be written with native endianness and the same
+    // break points and coefficients types (POSIX systems only).
+    template<typename _Scalar, typename _Coeff = _Scalar>
+    class MappedSplineFile
+    {
+        public:
+            typedef _Scalar Scalar;
+            typedef _Coeff CoeffScalar;
+            typedef SplineView<Scalar,CoeffScalar> View;
+
+            explicit MappedSplineFile(const std::filesystem::path& path) : _data(nullptr), _size(0), _count(0), _offsets(nullptr)
+            {
+                const int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                    throw std::runtime_error("Invalid path: " + path.generic_string());
+                struct stat st;
+                if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < SplineHeaderSize) {
+                    ::close(fd);
+                    throw std::runtime_error("Invalid spline file: " + path.generic_string());
+                }
+                _size = std::size_t(st.st_size);
+                void* data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (data == MAP_FAILED)
+                    throw std::runtime_error("Failed to map spline file: " + path.generic_string());
+                _data = static_cast<const char*>(data);
+
+                internal::SplineHeader header;
+                std::memcpy(&header, _data, sizeof(header));
+                try {
+                    if (internal::CheckHeader(header, "SPLF"))
+                        throw std::runtime_error("Spline file endianness differs from native, it can't be mapped (use load)");
+                    if (header.scalar != SplineTypeCode<Scalar> || header.coeff != SplineTypeCode<CoeffScalar>)
+                        throw std::runtime_error("Spline file types differ from MappedSplineFile types");
+                    if (header.size > (_size - SplineHeaderSize)/sizeof(std::uint64_t))
+                        throw std::runtime_error("Truncated spline file: " + path.generic_string());
+                    _CheckRecords(reinterpret_cast<const std::uint64_t*>(_data + SplineHeaderSize), header.size, path);
+                } catch (...) {
+                    ::munmap(const_cast<char*>(_data), _size);
+                    throw;
+                }
+                _count = header.size;
+                _offsets = reinterpret_cast<const std::uint64_t*>(_data + SplineHeaderSize);
+            }
+
+            MappedSplineFile(const MappedSplineFile&) = delete;
+            MappedSplineFile& operator=(const MappedSplineFile&) = delete;
+
+            MappedSplineFile(MappedSplineFile&& other) noexcept
+            : _data(std::exchange(other._data,nullptr)), _size(std::exchange(other._size,0)),
+              _count(std::exchange(other._count,0)), _offsets(std::exchange(other._offsets,nullptr)) {}
+
+            ~MappedSplineFile()
+            {
+                if (_data)
+                    ::munmap(const_cast<char*>(_data), _size);
+            }
+
+            inline std::size_t size() const { return _count; }
+
+            inline View operator[](const std::size_t i) const
+            {
+                assert((i < _count) && "Spline index out of range.");
+                const char* record = _data + _offsets[i];
+                std::uint64_t n;
+                std::memcpy(&n, record + offsetof(internal::SplineHeader,size), sizeof(n));
+                assert((_offsets[i] + internal::RecordSize<Scalar,CoeffScalar>(n) <= _size) && "Truncated spline file.");
+                const Scalar* breaks = reinterpret_cast<const Scalar*>(record + SplineHeaderSize);
+                const CoeffScalar* coeffs = reinterpret_cast<const CoeffScalar*>(
+                        record + SplineHeaderSize + internal::PaddedSize(n*sizeof(Scalar),8));
+                return View(breaks, coeffs, Eigen::Index(n));
+            }
+
+        private:
+            const char* _data;
+            std::size_t _size;
+            std::size_t _count;
+            const std::uint64_t* _offsets;
+
+            // validate all record offsets and sizes once, so that operator[] never reads past the mapping
+            inline void _CheckRecords(const std::uint64_t* offsets, const std::size_t count, const std::filesystem::path& path) const
+            {
+                const std::size_t first = SplineHeaderSize + count*sizeof(std::uint64_t);
+                for (std::size_t i = 0; i < count; ++i) {
+                    const std::uint64_t offset = offsets[i];
+                    if (offset < first || offset % SplineRecordAlignment != 0 || offset > _size - SplineHeaderSize)
+                        throw std::runtime_error("Invalid spline record offset " + std::to_string(i) + ": " + path.generic_string());
+                    internal::SplineHeader header;
+                    std::memcpy(&header, _data + offset, sizeof(header));
+                    if (internal::CheckHeader(header, "SPLN") || header.scalar != SplineTypeCode<Scalar> ||
+                            header.coeff != SplineTypeCode<CoeffScalar>)
+                        throw std::runtime_error("Invalid spline record " + std::to_string(i) + ": " + path.generic_string());
+                    // n bounded first, so that the record size can't overflow
+                    const std::size_t n = header.size;
+                    if (n < 2 || n > (_size - offset)/sizeof(Scalar) ||
+                            offset + internal::RecordSize<Scalar,CoeffScalar>(n) > _size)
+                        throw std::runtime_error("Truncated spline record " + std::to_string(i) + ": " + path.generic_string());
+                }
+            }
+    };
+}
+#endif
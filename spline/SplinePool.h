@@ -0,0 +1,244 @@
+/*
+ * This file is part of the Cpp utils distribution (https://github.com/feodorp/Cpp
+ * Copyright (C) 2022 Feodor Pisnitchenko
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SplinePool_h
+#define _SplinePool_h
+
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Spline1D.h"
+
+namespace Spline {
+
+    // Many natural cubic splines of varying size in one arena: break points of all splines in one
+    // contiguous array, coefficients in another, each spline being a slot given by its offsets.
+    // Splines are identified by the index returned by add(). Slot layout is the one of SplineView
+    // (n break points, (n-1)x4 column-major coefficients), so spline(id) is a view into the arena.
+    //
+    // Refitting a spline with at most as many points as its slot holds is done in place, without
+    // allocation (for mixed precision pools the fit uses temporaries in the fit precision, as Spline).
+    // Bigger refits move the spline to the end of the arena; compact() drops the unused space.
+    template<typename _Scalar, typename _Coeff>
+    class SplinePool
+    {
+        public:
+            typedef _Scalar Scalar;
+            typedef _Coeff CoeffScalar;
+            typedef SplineView<Scalar,CoeffScalar> View;
+
+            SplinePool() : _slots(), _breaks(), _coeffs() {}
+
+            // reserve arena space for "num_splines" splines with "num_breaks" break points in total
+            inline void reserve(const Eigen::Index num_splines, const Eigen::Index num_breaks)
+            {
+                _slots.reserve(num_splines);
+                _breaks.reserve(num_breaks);
+                _coeffs.reserve(4*(num_breaks - num_splines));
+            }
+
+            // remove all splines, keeping arena memory for new ones
+            inline void clear()
+            {
+                _slots.clear();
+                _breaks.clear();
+                _coeffs.clear();
+            }
+
+            inline Eigen::Index size() const { return Eigen::Index(_slots.size()); }
+            inline Eigen::Index num_breaks(const Eigen::Index id) const { return _slots[id].num_breaks; }
+
+            // arena memory in bytes (allocated)
+            inline std::size_t memory() const
+            {
+                return _slots.capacity()*sizeof(Slot) + _breaks.capacity()*sizeof(Scalar) + _coeffs.capacity()*sizeof(CoeffScalar);
+            }
+
+            // fit a new spline to interpolation points (x,y), returns its id
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline Eigen::Index add(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
+            {
+                _AssertSize(x,y);
+                const Eigen::Index id = size();
+                _slots.push_back(_Allocate(x.size()));
+                _Fit(_slots.back(), x, y);
+                return id;
+            }
+
+            // bulk fit: x and y hold the interpolation points of consecutive splines, sizes(k) points for
+            // the k-th one. The arena grows once and splines are fitted by "num_threads" threads.
+            // Returns the id of the first new spline, the others follow consecutively.
+            template<typename ArrayTypeX, typename ArrayTypeY, typename ArrayTypeS>
+            inline Eigen::Index add(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y,
+                    const Eigen::ArrayBase<ArrayTypeS>& sizes, unsigned int num_threads = 0)
+            {
+                assert((y.size() == x.size() && sizes.sum() == x.size()) && "Interpolation points must match spline sizes.");
+                const Eigen::Index id = size();
+                const Eigen::Index m = sizes.size();
+                std::vector<Eigen::Index> first(m + 1);
+                first[0] = 0;
+                for (Eigen::Index k = 0; k < m; ++k) {
+                    assert((sizes(k) > 1) && " Number of interpolation points is less then 2.");
+                    first[k+1] = first[k] + Eigen::Index(sizes(k));
+                }
+                _slots.reserve(_slots.size() + m);
+                _breaks.reserve(_breaks.size() + x.size());
+                _coeffs.reserve(_coeffs.size() + 4*(x.size() - m));
+                for (Eigen::Index k = 0; k < m; ++k)
+                    _slots.push_back(_Allocate(Eigen::Index(sizes(k))));
+
+                // don't spawn threads for less than MinBreaksPerThread break points each
+                constexpr Eigen::Index MinBreaksPerThread = 16384;
+                if (num_threads == 0)
+                    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+                num_threads = unsigned(std::clamp(x.size() / MinBreaksPerThread, Eigen::Index(1), Eigen::Index(num_threads)));
+
+                auto fit = [&](const Eigen::Index k0, const Eigen::Index k1) {
+                    for (Eigen::Index k = k0; k < k1; ++k)
+                        _Fit(_slots[id+k], x.segment(first[k], first[k+1]-first[k]), y.segment(first[k], first[k+1]-first[k]));
+                };
+                if (num_threads == 1) {
+                    fit(Eigen::Index(0), m);
+                } else {
+                    // split splines in ranges of about the same number of break points
+                    std::vector<Eigen::Index> bounds(num_threads + 1, m);
+                    bounds[0] = 0;
+                    for (unsigned int t = 1; t < num_threads; ++t)
+                        bounds[t] = Eigen::Index(std::lower_bound(first.begin(), first.end(), x.size()*t/num_threads) - first.begin());
+                    std::vector<std::thread> threads;
+                    for (unsigned int t = 1; t < num_threads; ++t)
+                        threads.emplace_back(fit, bounds[t], bounds[t+1]);
+                    fit(bounds[0], bounds[1]);
+                    for (std::thread& thread : threads)
+                        thread.join();
+                }
+                return id;
+            }
+
+            // refit spline "id" to new interpolation points (in place if they fit in its slot)
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline void refit(const Eigen::Index id, const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
+            {
+                _AssertSize(x,y);
+                if (x.size() > _slots[id].capacity)
+                    _slots[id] = _Allocate(x.size());
+                _slots[id].num_breaks = x.size();
+                _Fit(_slots[id], x, y);
+            }
+
+            // move all splines to new arrays without unused slot space (slots keep their sizes as capacity)
+            inline void compact()
+            {
+                Eigen::Index num_breaks = 0;
+                for (const Slot& slot : _slots)
+                    num_breaks += slot.num_breaks;
+                std::vector<Scalar> breaks;
+                std::vector<CoeffScalar> coeffs;
+                breaks.reserve(num_breaks);
+                coeffs.reserve(4*(num_breaks - size()));
+                for (Slot& slot : _slots) {
+                    const Eigen::Index n = slot.num_breaks;
+                    const Eigen::Index b = Eigen::Index(breaks.size()), c = Eigen::Index(coeffs.size());
+                    breaks.insert(breaks.end(), _breaks.begin() + slot.breaks, _breaks.begin() + slot.breaks + n);
+                    coeffs.insert(coeffs.end(), _coeffs.begin() + slot.coeffs, _coeffs.begin() + slot.coeffs + 4*(n-1));
+                    slot = Slot{b, c, n, n};
+                }
+                _breaks.swap(breaks);
+                _coeffs.swap(coeffs);
+            }
+
+            inline View spline(const Eigen::Index id) const
+            {
+                const Slot& slot = _slots[id];
+                return View(_breaks.data() + slot.breaks, _coeffs.data() + slot.coeffs, slot.num_breaks);
+            }
+
+            inline Scalar operator()(const Eigen::Index id, const Scalar x) const { return spline(id)(x); }
+
+            // evaluation of spline ids(i) at x(i)
+            template<typename ArrayTypeI, typename ArrayTypeX>
+            inline Eigen::Array<Scalar,ArrayTypeX::RowsAtCompileTime,ArrayTypeX::ColsAtCompileTime>
+            operator()(const Eigen::ArrayBase<ArrayTypeI>& ids, const Eigen::ArrayBase<ArrayTypeX>& x) const
+            {
+                assert((ids.size() == x.size()) && "Spline ids and points arrays must have same size.");
+                Eigen::Array<Scalar,ArrayTypeX::RowsAtCompileTime,ArrayTypeX::ColsAtCompileTime> y(x.rows(),x.cols());
+                for (Eigen::Index i = 0; i < x.size(); ++i)
+                    y(i) = (*this)(Eigen::Index(ids(i)), Scalar(x(i)));
+                return y;
+            }
+
+        private:
+            // arena offsets of break points and coefficients, number of break points and slot capacity
+            struct Slot
+            {
+                Eigen::Index breaks;
+                Eigen::Index coeffs;
+                Eigen::Index num_breaks;
+                Eigen::Index capacity;
+            };
+
+            typedef Spline<Scalar,Eigen::Dynamic,SoALayout,CoeffScalar> SplineType;
+
+            std::vector<Slot> _slots;
+            std::vector<Scalar> _breaks;
+            std::vector<CoeffScalar> _coeffs;
+
+            // new slot for n break points at the end of the arena
+            inline Slot _Allocate(const Eigen::Index n)
+            {
+                const Slot slot{Eigen::Index(_breaks.size()), Eigen::Index(_coeffs.size()), n, n};
+                _breaks.resize(_breaks.size() + n);
+                _coeffs.resize(_coeffs.size() + 4*(n-1));
+                return slot;
+            }
+
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline void _Fit(const Slot& slot, const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y)
+            {
+                const Eigen::Index n = slot.num_breaks;
+                Eigen::Map<Eigen::Array<Scalar,Eigen::Dynamic,1>> breaks(_breaks.data() + slot.breaks, n);
+                Eigen::Map<Eigen::Array<CoeffScalar,Eigen::Dynamic,4>> coeffs(_coeffs.data() + slot.coeffs, n-1, 4);
+
+                // fit with the precision of the interpolation points if it's higher than the storage one
+                typedef std::common_type_t<Scalar,typename ArrayTypeX::Scalar,typename ArrayTypeY::Scalar> FitScalar;
+                if constexpr (std::is_same_v<FitScalar,Scalar> && std::is_same_v<FitScalar,CoeffScalar>) {
+                    // solve in the arena slot: no allocation
+                    SplineType::_Solve(x.template cast<Scalar>(), y.template cast<Scalar>(), breaks, coeffs);
+                } else {
+                    Eigen::Array<FitScalar,Eigen::Dynamic,1> fit_breaks(n);
+                    Eigen::Array<FitScalar,Eigen::Dynamic,4> fit_coeffs(n-1,4);
+                    // break points rounded to Scalar first, so that the polynomials fit the stored breaks
+                    SplineType::_Solve(x.template cast<Scalar>().template cast<FitScalar>(), y.template cast<FitScalar>(),
+                            fit_breaks, fit_coeffs);
+                    breaks = fit_breaks.template cast<Scalar>();
+                    coeffs = fit_coeffs.template cast<CoeffScalar>();
+                }
+            }
+
+            template<typename ArrayTypeX, typename ArrayTypeY>
+            inline void _AssertSize(const Eigen::ArrayBase<ArrayTypeX>& x, const Eigen::ArrayBase<ArrayTypeY>& y) const
+            {
+                assert( (y.size() == x.size()) && "x and y-coordenates vectors of interpolation points must have same size.");
+                assert( (x.size() > 1) && " Number of interpolation points is less then 2.");
+            }
+    };
+
+}
+
+#endif
@@ -0,0 +1,399 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Spline1D.h"
+#include "SplinePool.h"
+#include "Spline2D.h"
+#include "Resample.h"
+
+// Spline benchmarks. Results are written as CSV (default) or JSON lines, one result per line:
+//   benchmark, scalar, size, variant, ns_per_op
+//
+// Usage: bench_spline [--max-size N] [--json] [--output file]
+
+using namespace Eigen;
+
+namespace {
+
+    struct Options
+    {
+        Index max_size = 1000000;
+        bool json = false;
+        std::string output;
+    };
+
+    class Report
+    {
+        public:
+            Report(std::ostream& out, bool json) : _out(out), _json(json)
+            {
+                if (!_json)
+                    _out << "benchmark,scalar,size,variant,ns_per_op" << std::endl;
+            }
+
+            void operator()(const std::string& benchmark, const std::string& scalar, Index size,
+                    const std::string& variant, double ns_per_op)
+            {
+                if (_json)
+                    _out << "{\"benchmark\": \"" << benchmark << "\", \"scalar\": \"" << scalar << "\", \"size\": " << size
+                         << ", \"variant\": \"" << variant << "\", \"ns_per_op\": " << ns_per_op << "}" << std::endl;
+                else
+                    _out << benchmark << "," << scalar << "," << size << "," << variant << "," << ns_per_op << std::endl;
+            }
+
+        private:
+            std::ostream& _out;
+            bool _json;
+    };
+
+    // keep results alive
+    volatile double sink;
+
+    // best time of 3 runs (each repeated at least 50 ms), in ns per operation
+    template<typename Function>
+    double Measure(Function&& f, Index ops_per_call)
+    {
+        typedef std::chrono::steady_clock Clock;
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; ++run) {
+            Index calls = 0;
+            const auto start = Clock::now();
+            auto stop = start;
+            do {
+                f();
+                ++calls;
+                stop = Clock::now();
+            } while (stop - start < std::chrono::milliseconds(50));
+            best = std::min(best, std::chrono::duration<double,std::nano>(stop - start).count() / double(calls*ops_per_call));
+        }
+        return best;
+    }
+
+    template<typename Scalar>
+    std::string ScalarName() { return std::is_same_v<Scalar,float> ? "float" : "double"; }
+
+    // non-uniform break points in [0,1] and oscillatory values
+    template<typename Scalar>
+    void Points(Index n, Array<Scalar,Dynamic,1>& x, Array<Scalar,Dynamic,1>& y)
+    {
+        std::mt19937 gen(12345);
+        std::uniform_real_distribution<double> step(0.5, 1.5), noise(-1.0, 1.0);
+        Array<double,Dynamic,1> xd(n);
+        xd(0) = 0.0;
+        for (Index i = 1; i < n; ++i)
+            xd(i) = xd(i-1) + step(gen);
+        xd /= xd(n-1);
+        x = xd.cast<Scalar>();
+        y = ((Scalar(20.0)*x).sin() + Scalar(0.1)*Array<Scalar,Dynamic,1>::NullaryExpr(n, [&]() { return Scalar(noise(gen)); }));
+    }
+
+    // oscillatory profile along one grid axis
+    Array<double,Dynamic,1> Profile(const Array<double,Dynamic,1>& x, const double frequency)
+    {
+        return (frequency*x).sin() + x;
+    }
+
+    // query streams
+    template<typename Scalar>
+    std::vector<std::pair<std::string,std::vector<Scalar>>> Queries(Index count)
+    {
+        std::mt19937 gen(54321);
+        std::uniform_real_distribution<Scalar> uniform(Scalar(0.0), Scalar(1.0));
+        std::normal_distribution<Scalar> cluster(Scalar(0.0), Scalar(1e-3));
+        std::vector<Scalar> random(count), sorted, clustered(count);
+        for (Scalar& q : random)
+            q = uniform(gen);
+        sorted = random;
+        std::sort(sorted.begin(), sorted.end());
+        Scalar center = uniform(gen);
+        for (Index i = 0; i < count; ++i) {
+            if (i % 64 == 0)
+                center = uniform(gen);
+            clustered[i] = std::clamp(center + cluster(gen), Scalar(0.0), Scalar(1.0));
+        }
+        return {{"sorted", sorted}, {"random", random}, {"clustered", clustered}};
+    }
+
+    template<typename Scalar>
+    void Construction(Report& report, const Options& options)
+    {
+        for (Index n = 10; n <= options.max_size; n *= 10) {
+            Array<Scalar,Dynamic,1> x, y;
+            Points(n, x, y);
+            Spline::Spline<Scalar> spline;
+            report("construction", ScalarName<Scalar>(), n, "dynamic",
+                    Measure([&]() { spline.set(x,y); sink = spline.coefs()(0,0); }, n));
+            if constexpr (std::is_same_v<Scalar,float>) {
+                Array<double,Dynamic,1> xd = x.template cast<double>(), yd = y.template cast<double>();
+                report("construction", ScalarName<Scalar>(), n, "dynamic_fit_double",
+                        Measure([&]() { spline.set(xd,yd); sink = spline.coefs()(0,0); }, n));
+            }
+        }
+    }
+
+    template<typename Scalar, int N>
+    void FixedConstruction(Report& report)
+    {
+        Array<Scalar,Dynamic,1> x, y;
+        Points(N, x, y);
+        const Array<Scalar,N,1> xf = x, yf = y;
+        auto fixed = std::make_unique<Spline::Spline<Scalar,N>>();
+        report("construction", ScalarName<Scalar>(), N, "fixed",
+                Measure([&]() { fixed->set(xf,yf); sink = fixed->coefs()(0,0); }, N));
+        Spline::Spline<Scalar> dynamic;
+        report("construction", ScalarName<Scalar>(), N, "dynamic",
+                Measure([&]() { dynamic.set(x,y); sink = dynamic.coefs()(0,0); }, N));
+        if constexpr (N <= 32) {
+            typename Spline::SmallSpline<Scalar,N>::Points xs, ys;
+            std::copy(x.begin(), x.end(), xs.begin());
+            std::copy(y.begin(), y.end(), ys.begin());
+            Spline::SmallSpline<Scalar,N> small;
+            report("construction", ScalarName<Scalar>(), N, "small",
+                    Measure([&]() { small.set(xs,ys); sink = small.coefs()[0][0]; }, N));
+
+            const auto queries = Queries<Scalar>(1024);
+            for (const auto& [name, q] : queries) {
+                auto run = [&](const std::string& variant, auto&& evaluate) {
+                    report("evaluation_" + name, ScalarName<Scalar>(), N, variant, Measure([&]() {
+                                double acc = 0.0;
+                                for (const Scalar v : q)
+                                    acc += evaluate(v);
+                                sink = acc;
+                            }, Index(q.size())));
+                };
+                run("fixed", [&](Scalar v) { return (*fixed)(v); });
+                run("dynamic", [&](Scalar v) { return dynamic(v); });
+                run("small", [&](Scalar v) { return small(v); });
+            }
+        }
+    }
+
+    template<typename Scalar>
+    void Evaluation(Report& report, const Options& options)
+    {
+        constexpr Index QueryCount = 1 << 16;
+        const auto queries = Queries<Scalar>(QueryCount);
+        for (Index n = 10; n <= options.max_size; n *= 10) {
+            Array<Scalar,Dynamic,1> x, y;
+            Points(n, x, y);
+            const Spline::Spline<Scalar> soa(x,y);
+            const Spline::Spline<Scalar,Dynamic,Spline::InterleavedLayout> interleaved(x,y);
+            // plain binary search over SoA data (no search index)
+            const Array<Scalar,Dynamic,4> coefs = soa.coefs();
+            const Spline::SplineView<Scalar> plain(soa.breaks().data(), coefs.data(), n);
+
+            for (const auto& [name, q] : queries) {
+                auto run = [&](const std::string& variant, auto&& evaluate) {
+                    report("evaluation_" + name, ScalarName<Scalar>(), n, variant, Measure([&]() {
+                                double acc = 0.0;
+                                for (const Scalar v : q)
+                                    acc += evaluate(v);
+                                sink = acc;
+                            }, QueryCount));
+                };
+                run("binary_search", [&](Scalar v) { return plain(v); });
+                run("soa", [&](Scalar v) { return soa(v); });
+                run("interleaved", [&](Scalar v) { return interleaved(v); });
+                auto hunter = soa.hunter();
+                run("hunter", [&](Scalar v) { return hunter(v); });
+
+                const Map<const Array<Scalar,Dynamic,1>> points(q.data(), Index(q.size()));
+                std::vector<Scalar> values(q.size());
+                report("evaluation_" + name, ScalarName<Scalar>(), n, "batch_1thread",
+                        Measure([&]() { soa.evaluate(points, values.data(), 1); sink = values[0]; }, QueryCount));
+                report("evaluation_" + name, ScalarName<Scalar>(), n, "batch_threads",
+                        Measure([&]() { soa.evaluate(points, values.data()); sink = values[0]; }, QueryCount));
+            }
+        }
+    }
+
+    // many small splines: one Spline object each against a SplinePool arena
+    void Pool(Report& report, const Options& options)
+    {
+        constexpr Index BreaksPerSpline = 16;
+        constexpr Index QueryCount = 1 << 16;
+        for (Index m = 1000; m*BreaksPerSpline <= options.max_size; m *= 10) {
+            Array<double,Dynamic,1> x1, y1;
+            Points(BreaksPerSpline, x1, y1);
+            const Array<double,Dynamic,1> x = x1.replicate(m,1), y = y1.replicate(m,1);
+            const Array<Index,Dynamic,1> sizes = Array<Index,Dynamic,1>::Constant(m, BreaksPerSpline);
+
+            std::vector<Spline::Spline<double>> splines;
+            report("pool_construction", "double", m, "vector", Measure([&]() {
+                        splines.clear();
+                        for (Index k = 0; k < m; ++k)
+                            splines.emplace_back(x.segment(k*BreaksPerSpline,BreaksPerSpline), y.segment(k*BreaksPerSpline,BreaksPerSpline));
+                        sink = splines.back().coefs()(0,0);
+                    }, m));
+            Spline::SplinePool<double> pool;
+            report("pool_construction", "double", m, "pool_1thread",
+                    Measure([&]() { pool.clear(); pool.add(x, y, sizes, 1); sink = pool(m-1, 0.5); }, m));
+            report("pool_construction", "double", m, "pool_threads",
+                    Measure([&]() { pool.clear(); pool.add(x, y, sizes); sink = pool(m-1, 0.5); }, m));
+            report("pool_refit", "double", m, "pool", Measure([&]() {
+                        for (Index k = 0; k < m; ++k)
+                            pool.refit(k, x.segment(k*BreaksPerSpline,BreaksPerSpline), y.segment(k*BreaksPerSpline,BreaksPerSpline));
+                        sink = pool(m-1, 0.5);
+                    }, m));
+
+            std::mt19937 gen(777);
+            std::uniform_int_distribution<Index> id(0, m-1);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            std::vector<std::pair<Index,double>> queries(QueryCount);
+            for (auto& [k, v] : queries)
+                k = id(gen), v = uniform(gen);
+            report("pool_evaluation", "double", m, "vector", Measure([&]() {
+                        double acc = 0.0;
+                        for (const auto& [k, v] : queries)
+                            acc += splines[k](v);
+                        sink = acc;
+                    }, QueryCount));
+            report("pool_evaluation", "double", m, "pool", Measure([&]() {
+                        double acc = 0.0;
+                        for (const auto& [k, v] : queries)
+                            acc += pool(k, v);
+                        sink = acc;
+                    }, QueryCount));
+        }
+    }
+
+    // streaming resampling of a big-endian sample file onto a grid twice as fine (ns per input sample)
+    void Resample(Report& report, const Options& options)
+    {
+        const std::filesystem::path input = std::filesystem::temp_directory_path() / "bench_spline_samples.bin";
+        const std::filesystem::path output = std::filesystem::temp_directory_path() / "bench_spline_resampled.bin";
+        for (Index n = 100000; n <= options.max_size; n *= 10) {
+            Array<double,Dynamic,1> x, y;
+            Points(n, x, y);
+            {
+                binIO::BinaryFile<binIO::Write> file(input);
+                std::vector<double> samples(2*n);
+                for (Index i = 0; i < n; ++i) {
+                    samples[2*i] = x(i);
+                    samples[2*i+1] = y(i);
+                }
+                file.write<std::endian::big>(samples.data(), samples.size());
+            }
+            report("resample", "double", n, "pipeline",
+                    Measure([&]() { sink = double(Spline::resample<double>(input, output, 0.5/double(n))); }, n));
+        }
+        std::filesystem::remove(input);
+        std::filesystem::remove(output);
+    }
+
+    // bicubic spline on n x n grids: fit (ns per grid point) and random point evaluation, against
+    // 1-D fits of the column at x of prebuilt row splines for each query
+    void Bicubic(Report& report, const Options& options)
+    {
+        constexpr Index QueryCount = 1 << 14;
+        std::mt19937 gen(999);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        Array<double,Dynamic,1> qx(QueryCount), qy(QueryCount);
+        for (Index k = 0; k < QueryCount; ++k)
+            qx(k) = uniform(gen), qy(k) = uniform(gen);
+        for (Index n = 10; n*n <= options.max_size; n *= 10) {
+            const Array<double,Dynamic,1> x = Array<double,Dynamic,1>::LinSpaced(n, 0.0, 1.0);
+            Array<double,Dynamic,1> xn, y;
+            Points(n, xn, y);
+            const Array<double,Dynamic,Dynamic> z = (Profile(x, 7.0).matrix() * Profile(xn, 5.0).matrix().transpose()).array();
+
+            Spline::Spline2D<double> uniform_spline, nonuniform_spline;
+            report("bicubic_construction", "double", n*n, "uniform",
+                    Measure([&]() { uniform_spline.set(x, x, z); sink = uniform_spline(0.5, 0.5); }, n*n));
+            report("bicubic_construction", "double", n*n, "nonuniform",
+                    Measure([&]() { nonuniform_spline.set(xn, xn, z); sink = nonuniform_spline(0.5, 0.5); }, n*n));
+            report("bicubic_evaluation", "double", n*n, "uniform",
+                    Measure([&]() { sink = uniform_spline(qx, qy).sum(); }, QueryCount));
+            report("bicubic_evaluation", "double", n*n, "nonuniform",
+                    Measure([&]() { sink = nonuniform_spline(qx, qy).sum(); }, QueryCount));
+            if (n <= 100) {
+                std::vector<Spline::Spline<double>> rows;
+                for (Index j = 0; j < n; ++j)
+                    rows.emplace_back(x, z.col(j));
+                Array<double,Dynamic,1> column(n);
+                report("bicubic_evaluation", "double", n*n, "per_query_1d_fits", Measure([&]() {
+                            double acc = 0.0;
+                            for (Index k = 0; k < 256; ++k) {
+                                for (Index j = 0; j < n; ++j)
+                                    column(j) = rows[j](qx(k));
+                                acc += Spline::Spline<double>(x, column)(qy(k));
+                            }
+                            sink = acc;
+                        }, 256));
+            }
+        }
+    }
+
+    template<int K>
+    void FixedMaxima(Report& report, const Spline::Spline<double>& spline)
+    {
+        report("maxima", "double", spline.num_breaks(), "fixed_K" + std::to_string(K),
+                Measure([&]() { sink = spline.template maxima<K>().y(0); }, spline.num_breaks()));
+    }
+
+    void Maxima(Report& report, const Options& options)
+    {
+        for (Index n = 1000; n <= options.max_size; n *= 10) {
+            Array<double,Dynamic,1> x, y;
+            Points(n, x, y);
+            const Spline::Spline<double> spline(x,y);
+            FixedMaxima<1>(report, spline);
+            FixedMaxima<10>(report, spline);
+            FixedMaxima<100>(report, spline);
+            for (Index k : {1, 10, 100, 1000}) {
+                report("maxima", "double", n, "runtime_K" + std::to_string(k) + "_1thread",
+                        Measure([&]() { sink = spline.maxima(k,1).y(0); }, n));
+                report("maxima", "double", n, "runtime_K" + std::to_string(k) + "_threads",
+                        Measure([&]() { sink = spline.maxima(k).y(0); }, n));
+            }
+            report("critical_points", "double", n, "all",
+                    Measure([&]() { sink = double(spline.critical_points().maxima.rows()); }, n));
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--max-size") && i + 1 < argc)
+            options.max_size = std::stol(argv[++i]);
+        else if (!std::strcmp(argv[i], "--json"))
+            options.json = true;
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+            options.output = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--max-size N] [--json] [--output file]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty())
+        file.open(options.output);
+    Report report(options.output.empty() ? std::cout : file, options.json);
+
+    Construction<double>(report, options);
+    Construction<float>(report, options);
+    FixedConstruction<double,16>(report);
+    FixedConstruction<double,128>(report);
+    FixedConstruction<double,1024>(report);
+    FixedConstruction<float,16>(report);
+    FixedConstruction<float,128>(report);
+    FixedConstruction<float,1024>(report);
+    Evaluation<double>(report, options);
+    Evaluation<float>(report, options);
+    Maxima(report, options);
+    Pool(report, options);
+    Resample(report, options);
+    Bicubic(report, options);
+}
@@ -1,7 +1,12 @@
 #include <Eigen/Dense>
+#include <filesystem>
 #include <iostream>
 #include <math.h>
 #include "Spline1D.h"
+#include "SplineIO.h"
+#include "SplinePool.h"
+#include "Spline2D.h"
+#include "Resample.h"
 
 
   template <typename T>
@@ -37,4 +42,106 @@ int main()
 
   std::cout << "10 ordered maxima values of sline [x, y]: " << std::endl;
   std::cout << M << std::endl;
+
+  std::cout << "5 ordered maxima values of sline [x, y] (runtime size, 2 threads): " << std::endl;
+  std::cout << Spl.maxima(5,2) << std::endl;
+
+  auto P = Spl.critical_points();
+  std::cout << "Number of maxima, minima and inflection points: " << P.maxima.rows() << " "
+            << P.minima.rows() << " " << P.inflections.rows() << std::endl << std::endl;
+
+  std::cout << "Derivatives at x = 0.5 (orders 1, 2, 3): " << Spl.derivative(0.5) << " "
+            << Spl.derivative(0.5,2) << " " << Spl.derivative(0.5,3) << std::endl;
+  std::cout << "Integral over [0.25, 0.75]: " << Spl.integral(0.25,0.75) << std::endl;
+  std::cout << "Integral over [0, 1]: " << Spl.integral() << std::endl;
+
+  auto hunt = Spl.hunter();
+  std::cout << "Spline at x = 0.1, 0.11, 0.12 (hunting): " << hunt(0.1) << " " << hunt(0.11) << " " << hunt(0.12) << std::endl;
+
+  Eigen::ArrayXd grid = Eigen::ArrayXd::LinSpaced(1000000,0.0,1.0);
+  Eigen::ArrayXd resampled = Spl(grid);                                 //batch evaluation on all cores
+  std::cout << "Spline at x = 0.5 (batch evaluation): " << resampled(500000) << " " << Spl(grid(500000)) << std::endl;
+
+  Spline::SplinePool<double> pool;
+  const Eigen::Index id = pool.add(x,y);
+  pool.refit(id, x, -y);                                                 //in place, no allocation
+  std::cout << "Spline at x = 0.1 (pool, refitted to -y): " << pool(id,0.1) << std::endl;
+
+  // float storage fitted from double points near x = 1e4. Against a double fit on the break points
+  // rounded to float the error is coefficient roundoff (u*max|y|); against a double fit on the exact
+  // points, break point and query rounding add about u*max|x|*max|S'|
+  Eigen::ArrayXd xl = 1e4 + Eigen::ArrayXd::LinSpaced(1000,0.0,10.0), yl = xl.sin();
+  const Eigen::ArrayXd xr = xl.cast<float>().cast<double>();
+  const Spline::Spline<double> exact(xl,yl), exact_rounded(xr,yl);
+  const Spline::Spline<float> rounded(xl,yl);
+  Spline::SplinePool<float> rounded_pool;
+  const Eigen::Index rid = rounded_pool.add(xl,yl);
+  double error = 0.0, error_rounded = 0.0, slope = 0.0;
+  for (const double q : Eigen::ArrayXd::LinSpaced(100000,xl(0),xl(999))) {
+    const float qf = float(q);
+    for (const double v : {double(rounded(qf)), double(rounded_pool(rid,qf))}) {
+      error = std::max(error, std::abs(v - exact(q)));
+      error_rounded = std::max(error_rounded, std::abs(v - exact_rounded(double(qf))));
+    }
+    slope = std::max(slope, std::abs(exact.derivative(q)));
+  }
+  const double u = std::ldexp(1.0,-24), bound_rounded = 4.0*u*yl.abs().maxCoeff(),
+               bound = bound_rounded + 4.0*u*xl.abs().maxCoeff()*slope;
+  std::cout << "Float spline fitted from double points near 1e4, max error and bound against fit on rounded breaks: "
+            << error_rounded << " " << bound_rounded << ", against exact fit: " << error << " " << bound
+            << (error_rounded <= bound_rounded && error <= bound ? " ok" : " FAILED") << std::endl;
+
+  Eigen::ArrayXXd z = y.matrix() * x.matrix().transpose();               //z(i,j) = y(i)*x(j)
+  Spline::Spline2D<double> S2(x, x, z);
+  std::cout << "Bicubic spline at (0.1, 0.5): " << S2(0.1,0.5) << " " << Spl(0.1)*0.5 << std::endl;
+
+  // 2001 samples in chunks of 1000: the last chunk has a single sample
+  Eigen::ArrayXd xs = Eigen::ArrayXd::LinSpaced(2001,0.0,1.0), ys = (10.0*xs).sin();
+  {
+    binIO::BinaryFile<binIO::Write|binIO::Truncate> file("samples.bin");
+    for (Eigen::Index i = 0; i < xs.size(); ++i) {
+      file.write<std::endian::big>(xs(i));
+      file.write<std::endian::big>(ys(i));
+    }
+  }
+  Spline::ResampleOptions options;
+  for (const auto& [chunk_size, overlap] : {std::pair<Eigen::Index,Eigen::Index>{1000, 0}, {1000, 1}, {1000, 32}, {2, 32}}) {
+    options.chunk_size = chunk_size;                                     //raised to overlap if smaller
+    options.overlap = overlap;                                           //0 is raised to 1
+    const Eigen::Index n = Spline::resample<double>("samples.bin", "resampled.bin", 1.0/4000.0, options);
+    binIO::BinaryFile<binIO::Read> file("resampled.bin");
+    const Spline::Spline<double> global(xs, ys);
+    double error = 0.0;
+    for (Eigen::Index k = 0; k < n; ++k) {
+      const double xk = file.read<double,std::endian::big>(), yk = file.read<double,std::endian::big>();
+      error = std::max(error, std::abs(yk - global(xk)));
+    }
+    std::cout << "Resampled points and max error against global fit (chunk size " << chunk_size << ", overlap " << overlap
+              << "): " << n << " " << error << std::endl;
+  }
+  std::filesystem::resize_file("samples.bin", std::filesystem::file_size("samples.bin") - 4);   //half a sample
+  try {
+    Spline::resample<double>("samples.bin", "resampled.bin", 1.0/4000.0);
+  } catch (const std::runtime_error& error) {
+    std::cout << "Sample file not resampled: " << error.what() << std::endl;
+  }
+
+  std::vector<Spline::Spline<double>> splines(1, Spline::Spline<double>(x,y));
+  Spline::save("splines.bin", splines);
+  Spline::MappedSplineFile<double> mapped("splines.bin");
+  std::cout << "Spline at x = 0.1 (memory mapped file): " << mapped[0](0.1) << std::endl;
+
+  std::filesystem::copy_file("splines.bin", "truncated.bin", std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::resize_file("truncated.bin", std::filesystem::file_size("splines.bin") - 8);   //writer crashed mid-save
+  try {
+    Spline::MappedSplineFile<double> truncated("truncated.bin");
+  } catch (const std::runtime_error& error) {
+    std::cout << "Truncated file not mapped: " << error.what() << std::endl;
+  }
+  try {
+    std::vector<Spline::Spline<double>> loaded;
+    Spline::load("truncated.bin", loaded);
+  } catch (const std::runtime_error& error) {
+    std::cout << "Truncated file not loaded: " << error.what() << std::endl;
+  }
 }